@@ -23,17 +23,17 @@ public:
 	void handleInterrupt();
 
 private:
+	void translatorChainCache();
+
 	void handleInterrupt_PREPARE_FOR_JUMP();
-	void handleInterrupt_USE_INTERPRETER();
 	void handleInterrupt_OUT_OF_CODE();
 	void handleInterrupt_PREPARE_FOR_INDIRECT_JUMP();
 	void handleInterrupt_SELF_MODIFYING_CODE();
 #ifdef USE_DEBUG_EXTRA
 	void handleInterrupt_DEBUG();
 #endif
-	void handleInterrupt_WAIT_FOR_KEYPRESS();
 	void handleInterrupt_PREPARE_FOR_STACK_JUMP();
-	void handleInterrupt_UPDATE_TIMERS();
+	void handleInterrupt_DISPATCH_MISS();
 #ifdef LIMIT_SPEED_BY_INSTRUCTIONS
 	void handleInterrupt_DELAY_INSTRUCTION();
 #endif
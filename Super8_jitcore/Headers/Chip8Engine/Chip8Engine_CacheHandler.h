@@ -5,33 +5,88 @@
 
 #include "Headers\Globals.h"
 #include "Headers\FastArrayList\FastArrayList.h"
+#include "Headers\Chip8Globals\Chip8Globals_C8_STATE.h"
+#include "Headers\Chip8Engine\Chip8Engine_CodeArena.h"
 
 #ifdef USE_DEBUG_EXTRA
 #define  MAX_CACHE_SZ 0xFFFF
+#define  CODE_ARENA_SZ 0x4000000 // 64MB, enough for 1024 caches (size of cache_list).
 #else
-#define  MAX_CACHE_SZ 0x7FF
+#define  MAX_CACHE_SZ 0x400 // Caches continue in a new cache when they get full (see Chip8Engine::translatorChainCache), so they can start small.
+#define  CODE_ARENA_SZ 0x400000 // 4MB
 #endif
 
+#define MAX_NUM_CACHES 1024 // Size of cache_list (cache indexes are always below this).
+#define MAX_OPCODE_X86_SZ 0x140 // Upper bound of the code emitted for one opcode (including the jump to a continuation cache, the V register write backs/loads around it and the loop head padding). 0xDXYN at the start of a block is the largest. A new cache is started when there is less room left than this (twice this before a skip, see Chip8Engine::translatorLoop).
+
+#define OUT_OF_CODE_STUB_SZ 23
+#define EXIT_JUMP_SZ 5 // JMP rel32
+#define CODE_MAP_PADDING 20 // DYNAREC_EMIT_SMC_CHECK reads up to 16 + 3 bytes past I (which is masked to 0xFFF).
+#define OPCODE_X86_OFFSET_NONE 0xFFFF // Used in x86_opcode_offsets for the opcodes jumped over by a followed 0x1NNN jump, which have no code, and for opcodes part way through a register allocation block.
+#define MAX_CACHE_INLINE_RANGES 4096 // Size of cache_inline_range_list.
+
 struct CACHE_REGION {
 	uint16_t c8_start_recompile_pc; // The start C8 pc for this cache (code inclusive).
 	uint16_t c8_end_recompile_pc; // The end C8 pc for this cache (code inclusive).
 	uint8_t c8_pc_alignement; // TESTING: used to signify the byte alignment of this cache. For chip8 roms, this is always either 0 (pc % 2 == 0) or 1 (pc % 2 == 1) as each opcode is always 2 bytes long.
 	uint8_t * x86_mem_address; // Used to store the base address of where the cache is stored in memory.
 	uint32_t x86_pc; // Used to tell how much code has been emitted to the cache (code size).
+	uint32_t x86_mem_sz; // Size of the block allocated from the code arena for this cache.
+	uint8_t invalid_flag; // Set when the cache has been invalidated (by self modifying code) and is waiting in cache_invalidate_list to be freed.
+	uint8_t truncated_flag; // Set when the code after c8_end_recompile_pc was cut off by self modifying code (see truncateCacheByIndex). The next OUT_OF_CODE continues translating from c8_end_recompile_pc + 2.
+	FastArrayList<uint16_t> * x86_opcode_offsets; // x86 offset (from x86_mem_address) of the code for each opcode, index = (C8 pc - c8_start_recompile_pc) / 2.
+	int32_t continuation_cache_index; // Cache which the code continues in, when this cache got full (see Chip8Engine::translatorChainCache). -1 if none.
+	uint32_t x86_cold_pc; // Offset of the cold code (rarely run interrupts, see beginColdCodeCurrent). Grows down from the OUT_OF_CODE stub, towards the normal code.
+	uint16_t reg_alloc_v_mask; // V registers (bit n = Vn) held in bl/bh by the blocks in this cache. They are written back before every exit, interrupt and self modifying code check (see Chip8Engine_Dynarec::beginRegAllocBlock).
+	int32_t continuation_from_head; // First cache whose continuation_cache_index is this one, the rest follow continuation_from_next. -1 if none.
+	int32_t continuation_from_next; // Links of the list this cache is on (the one of its continuation_cache_index). -1 at the ends.
+	int32_t continuation_from_prev;
+	uint16_t inline_range_count; // Number of subroutines inlined into this cache (in cache_inline_range_list).
 	//uint8_t stop_write_flag; // Used to signify that no more code should be emitted to this cache (usually because it ends in a jump).
 };
 
+// A subroutine which was translated into a cache at a 0x2NNN call (see Chip8Engine_Dynarec::canInlineSubroutine). Its code is outside of the cache C8 range, so it is tracked here for invalidation.
+struct CACHE_INLINE_RANGE {
+	int32_t cache_index;
+	uint16_t c8_call_pc; // C8 PC of the 0x2NNN opcode in the cache.
+	uint16_t c8_start_pc; // The subroutine C8 PC range (code inclusive, same as the cache range).
+	uint16_t c8_end_pc;
+};
+
+// Direct-mapped directory over the C8 address space, used to lookup regions by C8 PC in O(1) instead of scanning the cache_list.
+// Each C8 address has its own entry, so both pc alignments (see CACHE_REGION::c8_pc_alignement) are covered separately.
+struct CACHE_DIRECTORY_ENTRY {
+	int32_t start_cache_index; // Index of the valid cache which starts at this C8 PC, or which has an entry point part way through its code at this C8 PC (see addEntryByC8PC). The x86 address is in cache_dispatch_table. -1 if none.
+	int32_t cover_cache_index; // Index of a valid cache whose code covers this C8 PC (with the same pc alignment). -1 if none.
+	uint16_t cover_count; // Number of valid caches covering this C8 PC. When > 1, the interval list is needed to find all of them.
+};
+
 class Chip8Engine_CacheHandler : ILogComponent
 {
 public:
-	FastArrayList<int32_t> * cache_invalidate_list;
+	FastArrayList<int32_t> * cache_invalidate_list; // Queue of caches waiting to be freed by invalidateCacheByFlag. A cache is only ever queued once (see CACHE_REGION::invalid_flag).
 	int32_t selected_cache_index = 0;
-	FastArrayList<CACHE_REGION> * cache_list;
+	FastArrayList<CACHE_REGION> * cache_list; // Indexes are stable: a freed cache leaves an empty slot (x86_mem_address == NULL) which is reused by the next allocation.
+	FastArrayList<int32_t> * cache_free_slot_list;
+	Chip8Engine_CodeArena * arena; // All cache memory (including the cdecl setup cache) is allocated from here.
+	CACHE_DIRECTORY_ENTRY cache_directory[MEMORY_SZ];
+	uint32_t cache_start_generation[MEMORY_SZ]; // Incremented every time the cache starting at a C8 PC is invalidated. Used by emitted code to check if a predicted return address is still valid.
+	uint8_t * cache_dispatch_table[MEMORY_SZ]; // x86 entry point of the cache starting at each C8 PC, or setup_cache_dispatch_miss if there is none. Read directly by emitted code for indirect jumps and returns (see DYNAREC_EMIT_DISPATCH_JUMP).
+	FastArrayList<int32_t> * cache_interval_list; // Indexes of all valid caches, sorted by c8_start_recompile_pc. Used to find every cache overlapping a C8 address range (see invalidateRange).
+	uint16_t cache_interval_max_span; // Upper bound of (c8_end_recompile_pc - c8_start_recompile_pc) over the caches in cache_interval_list. Only grows, reset when the list is empty.
+	uint8_t code_map[MEMORY_SZ + CODE_MAP_PADDING]; // Shadow map of C8 memory, set to 1 for each byte covered by a valid cache. Read directly by emitted code (see DYNAREC_EMIT_SMC_CHECK).
+	uint16_t code_map_count[MEMORY_SZ]; // Number of valid caches covering each byte, code_map is 1 when this is > 0.
+	FastArrayList<CACHE_INLINE_RANGE> * cache_inline_range_list; // Sorted by c8_start_pc, the same as cache_interval_list. Also counted in code_map_count, until the cache is freed.
+	uint16_t cache_inline_range_max_span; // Upper bound of (c8_end_pc - c8_start_pc) over the ranges in cache_inline_range_list, the same as cache_interval_max_span.
+	uint8_t inline_range_active; // Set while a subroutine is being inlined, so setCacheEndC8PCCurrent updates inline_range_current instead of the cache.
+	CACHE_INLINE_RANGE inline_range_current; // The subroutine being inlined. Added to cache_inline_range_list by endInlineRangeCurrent, once its end pc is known.
 
 	uint8_t * setup_cache_cdecl;
 	uint8_t setup_cache_cdecl_sz;
 	uint8_t * setup_cache_return_jmp_address;
-	uint8_t * setup_cache_eip_hack;
+	uint8_t * setup_cache_dispatch_miss;
+	uint8_t * setup_cache_exit; // Shared tail of all interrupts: eax = resume address, cl = status code, upper 16 bits of ecx = x86_interrupt_c8_param1.
+	uint8_t * setup_cache_exit_param2; // Same as setup_cache_exit, but also stores dx into x86_interrupt_c8_param2.
 
 	Chip8Engine_CacheHandler();
 	~Chip8Engine_CacheHandler();
@@ -43,13 +98,21 @@ public:
 	void initFirstCache();
 
 	// BELOW FUNCTIONS HANDLE ALLOCATION
-	int32_t getCacheWritableByStartC8PC(uint16_t c8_jump_pc); // Used when a jump is made (see jumphandler.cpp). Contains more code path logic and handles invalidation.
+	int32_t getCacheWritableByStartC8PC(uint16_t c8_jump_pc); // Used when a jump is made (see jumphandler.cpp). Contains more code path logic and handles invalidation. The returned cache may start before c8_jump_pc, use getEntryX86AddressByIndex for where to jump to.
+	uint8_t * getEntryX86AddressByIndex(int32_t index, uint16_t c8_pc_); // x86 address to enter the cache at, for a jump to c8_pc_.
 
 	// INVALIDATION FUNCTIONS
 	void invalidateCacheByFlag();
 	void setInvalidFlagByIndex(int32_t index);
 	void setInvalidFlagByC8PC(uint16_t c8_pc_);
+	void invalidateRange(uint16_t c8_start_pc_, uint16_t c8_length_); // Sets the invalid flag of every cache with code in [c8_start_pc_, c8_start_pc_ + c8_length_). Each cache is only flagged once.
 	uint8_t getInvalidFlagByIndex(int32_t index);
+	void recordOpcodeX86OffsetCurrent(uint16_t c8_pc_); // Called by the translator before each opcode is emitted, so the cache can later be truncated at that opcode.
+	void recordOpcodeX86OffsetNoneCurrent(uint16_t c8_pc_); // Same as recordOpcodeX86OffsetCurrent, for an opcode inside a register allocation block. Its V registers are not in memory, so it can't be entered or truncated at.
+	void recordOpcodeX86OffsetGapCurrent(uint16_t c8_to_pc_); // Marks the opcodes up to (not including) c8_to_pc_ as having no code, when a jump is followed over them.
+	uint8_t isSkipOpcode(uint16_t opcode); // Skip opcodes jump over the next opcode, so the cache can't be cut off straight after one.
+	void writeExitJumpCurrent();
+	void writeExitJumpByIndex(int32_t index); // Writes a jump to the OUT_OF_CODE stub at the end of the emitted code. x86_pc is not changed, so the jump is overwritten by the next code emitted.
 
 	// BELOW FUNCTIONS DO NOT ALLOCATE CACHES, THESE ARE ONLY USED FOR FINDING
 	int32_t findCacheIndexCurrent();
@@ -59,12 +122,18 @@ public:
 
 	void switchCacheByC8PC(uint16_t c8_pc_);
 	void switchCacheByIndex(int32_t index);
+	void setContinuationByIndex(int32_t index, int32_t continuation_index); // Records that the full cache at index continues in continuation_index (see Chip8Engine::translatorChainCache).
 
 	void incrementCacheX86PC(uint8_t count);
 	void setCacheEndC8PCCurrent(uint16_t c8_end_pc_);
 	void setCacheEndC8PCByIndex(int32_t index, uint16_t c8_end_pc_);
+	void beginInlineRangeCurrent(uint16_t c8_call_pc_, uint16_t c8_start_pc_); // Opcodes translated until endInlineRangeCurrent() belong to the subroutine at c8_start_pc_.
+	void endInlineRangeCurrent();
 	uint16_t getEndC8PCCurrent();
 	uint8_t * getEndX86AddressCurrent();
+	uint32_t getFreeX86SpaceCurrent(); // Number of bytes that can still be emitted before the cold code (or the OUT_OF_CODE stub), less the room kept for the exit jump.
+	uint8_t * beginColdCodeCurrent(uint32_t sz); // Code is written to sz bytes of new cold code (returned) until endColdCodeCurrent(), then carries on where it was. Exactly sz bytes must be written.
+	void endColdCodeCurrent();
 
 	CACHE_REGION * getCacheInfoCurrent();
 	CACHE_REGION * getCacheInfoByIndex(int32_t index);
@@ -79,7 +148,36 @@ public:
 #endif
 
 private:
+	uint32_t cold_code_start; // Offset of the cold code being written, between beginColdCodeCurrent and endColdCodeCurrent.
+	uint32_t cold_code_saved_x86_pc; // x86_pc of the normal code, restored by endColdCodeCurrent.
+	uint8_t cold_code_active; // Set between beginColdCodeCurrent and endColdCodeCurrent, when the space kept for the exit jump is not needed.
+
 	int32_t allocNewCacheByC8PC(uint16_t c8_start_pc_); // The main allocation function
 	int32_t allocAndSwitchNewCacheByC8PC(uint16_t c8_start_pc_);
 	void deallocAllCacheExit();
+	void exitCacheOverflow();
+	void writeOutOfCodeStub(uint8_t * x86_address, uint8_t * cache_mem); // Emits the OUT_OF_CODE interrupt (OUT_OF_CODE_STUB_SZ bytes) for the cache at cache_mem.
+
+	// PARTIAL INVALIDATION FUNCTIONS
+	uint8_t truncateCacheByIndex(int32_t index, uint16_t c8_pc_); // Cuts the cache off before the opcode containing c8_pc_. Returns 0 if it can't be done (the whole cache needs to be invalidated instead).
+
+	// ENTRY POINT FUNCTIONS
+	int32_t addEntryByC8PC(uint16_t c8_pc_); // Enters an existing translation part way through instead of allocating a new cache. Returns the cache index, -1 if no cache can be entered at c8_pc_.
+	uint8_t isEntryPointByIndex(int32_t index, uint16_t c8_pc_); // Checks the code for c8_pc_ can be jumped to directly (all C8 state is in memory at the start of every translated opcode).
+	void removeEntriesByIndex(int32_t index, uint16_t c8_from_pc_); // Removes the entry points at or after c8_from_pc_ (not the start of the cache), so jumps go through the jump table/dispatch miss again.
+	void clearContinuationByIndex(int32_t index);
+
+	// DIRECTORY FUNCTIONS
+	void resetDirectory();
+	void addDirectoryRangeByIndex(int32_t index, uint16_t c8_from_pc_, uint16_t c8_to_pc_); // Both inclusive, stepping by 2 so only the pc alignment of the cache is touched.
+	void removeDirectoryRangeByIndex(int32_t index, uint16_t c8_from_pc_, uint16_t c8_to_pc_);
+
+	// INTERVAL FUNCTIONS
+	int32_t findIntervalUpperBound(uint16_t c8_pc_); // Returns the position in cache_interval_list of the first cache with a start pc > c8_pc_ (binary search).
+	void addIntervalByIndex(int32_t index);
+	void removeIntervalByIndex(int32_t index);
+
+	// INLINE RANGE FUNCTIONS
+	int32_t findInlineRangeUpperBound(uint16_t c8_pc_); // Returns the position in cache_inline_range_list of the first range with a start pc > c8_pc_ (binary search).
+	void removeInlineRangesByIndex(int32_t index, uint16_t c8_from_call_pc_); // Removes the ranges of subroutines called at or after c8_from_call_pc_ in the cache.
 };
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Headers\Globals.h"
+#include "Headers\FastArrayList\FastArrayList.h"
+
+#define CODE_ARENA_MIN_BLOCK_SZ 0x100 // Smallest size class (256 bytes). Size classes go up in powers of 2 from here.
+#define CODE_ARENA_NUM_SIZE_CLASSES 9 // 256 bytes -> 64KB
+#define CODE_ARENA_MAX_FREE_BLOCKS 4096 // Per size class. Caches are limited by the cache_list size (1024) so this is never reached.
+#define CODE_ARENA_COMMIT_SZ 0x10000 // Reserved memory is committed in chunks of this size as the bump pointer moves forward.
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// CodeArena reserves one large block of executable memory up front and hands out blocks from it //
+// using a bump allocator, with a free list per size class so freed blocks are reused without    //
+// going back to the OS.                                                                         //
+//                                                                                               //
+// The arena is never writable and executable at the same time (W^X). Anything that modifies     //
+// cache memory must call beginWrite() first, and endWrite() must be called before executing the //
+// cache. Both only change the page protection when the state actually changes, so the flips are //
+// batched: at most one of each per dispatcher loop, and none when no code was written.          //
+// Uses VirtualAlloc/VirtualProtect, so it is WIN32 only (like the rest of the project).         //
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+class Chip8Engine_CodeArena : ILogComponent
+{
+public:
+	Chip8Engine_CodeArena(uint32_t arena_sz_);
+	~Chip8Engine_CodeArena();
+
+	std::string getComponentName();
+
+	uint8_t * allocBlock(uint32_t sz); // Returns a block of at least sz bytes (rounded up to the size class). Exits if the arena is full.
+	void freeBlock(uint8_t * address, uint32_t sz); // sz must be the same size given to allocBlock.
+	uint32_t getBlockSize(uint32_t sz); // Returns the real size of a block allocated with sz bytes.
+
+	inline void beginWrite() { if (!arena_writable) setProtection(true); } // Makes the arena writable (and not executable).
+	inline void endWrite() { if (arena_writable) setProtection(false); } // Makes the arena executable (and not writable).
+
+#ifdef USE_DEBUG
+	void DEBUG_printArena();
+#endif
+
+private:
+	uint8_t * arena_mem; // Base address of the reserved memory.
+	uint32_t arena_sz; // Total reserved size.
+	uint32_t arena_commit_sz; // How much of the reserved memory has been committed so far.
+	uint32_t arena_bump_offset; // Offset of the next never-used block.
+	bool arena_writable; // Current protection of the committed memory (true = RW, false = RX).
+	FastArrayList<uint8_t *> * free_lists[CODE_ARENA_NUM_SIZE_CLASSES];
+
+	uint8_t getSizeClass(uint32_t sz);
+	void commitTo(uint32_t offset);
+	void setProtection(bool writable);
+};
\ No newline at end of file
@@ -3,9 +3,14 @@
 #include <cstdint>
 
 #include "Headers\Globals.h"
+#include "Headers\FastArrayList\FastArrayList.h"
+#include "Headers\Chip8Globals\Chip8Globals_X86_HELPERS.h"
 
 #define MODREGRM_RM_DISP32 5
 #define MODREGRM_RM_SIB 4
+#define JMP_M_PTR_32_X86_SZ 6 // JMP dword [address]
+#define DYNAREC_INTERRUPT_X86_SZ 15 // Size of DYNAREC_EMIT_INTERRUPT (with one param): MOV eax, MOV ecx and JMP rel32.
+#define MAX_LABEL_FIXUPS 64 // Unbound label fixups at any one time. Only skips within the block being translated use labels, so only a few are ever outstanding.
 
 enum X86Register {
 	al = 0, ax = 0, eax = 0,
@@ -18,6 +23,12 @@ enum X86Register {
 	bh = 7, di = 7, edi = 7
 };
 
+struct X86_LABEL_FIXUP {
+	uint16_t c8_label; // C8 PC the jump goes to. The label gets bound when the translator reaches this PC.
+	uint8_t * x86_address_fixup; // Address of the relative value to fill in.
+	uint8_t fixup_sz; // Size of the relative value (1 = rel8, 4 = rel32).
+};
+
 class Chip8Engine_CodeEmitter_x86 : ILogComponent 
 {
 public:
@@ -32,11 +43,21 @@ public:
 #endif
 	void DYNAREC_EMIT_INTERRUPT(Chip8Globals::X86_STATE::X86_INT_STATUS_CODE code, uint16_t c8_opcode);
 	void DYNAREC_EMIT_INTERRUPT(Chip8Globals::X86_STATE::X86_INT_STATUS_CODE code, uint16_t c8_opcode, uint16_t c8_return_pc);
-	void DYNAREC_EMIT_MOV_EAX_EIP();
-	void DYNAREC_EMIT_RETURN_CDECL_JUMP();
+	void DYNAREC_EMIT_INTERRUPT_JNE_COLD(Chip8Globals::X86_STATE::X86_INT_STATUS_CODE code, uint16_t c8_opcode); // Takes the interrupt only if ZF = 0. The interrupt is put in the cold code of the cache and resumes straight after the jump.
+	void DYNAREC_EMIT_ALIGN(uint8_t alignment); // Pads with NOPs until the current x86 address is a multiple of alignment (a power of 2).
+	void DYNAREC_EMIT_HELPER_CALL(Chip8Globals::X86_HELPERS::X86_HELPER_FUNC * helper, Chip8Globals::X86_STATE::X86_INT_STATUS_CODE code, uint16_t c8_opcode); // Calls the helper with c8_opcode and continues. Only exits with code if the helper asks for it.
+	void DYNAREC_EMIT_SMC_CHECK(uint16_t c8_opcode, uint8_t num_bytes); // Emits a SELF_MODIFYING_CODE interrupt which is only taken when [I, I + num_bytes) overlaps translated code (see CacheHandler code_map).
+	void DYNAREC_EMIT_DISPATCH_JUMP(); // Jumps to the cache for the C8 PC in eax (upper 16 bits must be 0) through CacheHandler::cache_dispatch_table. Exits with DISPATCH_MISS if there is no cache yet.
+	void DYNAREC_EMIT_EXIT_JUMP(uint8_t * x86_exit_stub); // Jumps to CacheHandler::setup_cache_exit(_param2), see DYNAREC_EMIT_INTERRUPT for the registers it expects.
+	void DYNAREC_EMIT_REG_ALLOC_LOADS(); // Loads the V registers of the current allocation block (Dynarec::reg_alloc_c8_reg) into bl/bh.
+	void DYNAREC_EMIT_REG_ALLOC_WRITE_BACK(); // Stores bl/bh back into their V registers, so C8_STATE::cpu.V is up to date.
+	bool isRegAllocated(uint8_t c8_reg); // True if the V register is held in bl/bh in the current allocation block, rather than in memory.
+	X86Register getRegAllocX86Register(uint8_t c8_reg); // Only valid if isRegAllocated(c8_reg).
 
 	void MOV_RtoM_8(uint8_t* dest, X86Register source);
 	void MOV_MtoR_8(X86Register dest, uint8_t* source);
+	void MOV_RtoR_8(X86Register dest, X86Register source);
+	void MOV_RtoR_32(X86Register dest, X86Register source);
 	void MOV_ImmtoR_8(X86Register dest, uint8_t immediate);
 	void MOV_ImmtoM_8(uint8_t* dest, uint8_t immediate);
 	void MOV_ImmtoR_32(X86Register dest, uint32_t immediate);
@@ -46,6 +67,16 @@ public:
 	void MOV_RtoM_16(uint16_t* dest, X86Register source);
 	void MOV_RtoPTR_8(X86Register PTR_dest, X86Register source);
 	void MOV_RtoM_32(uint32_t* dest, X86Register source);
+	void MOV_PTRtoR_32(X86Register dest, X86Register PTR_source);
+	void MOV_ImmtoIdxM_16(uint16_t* base, X86Register index, uint16_t immediate); // MOV word [base + index * 2], immediate
+	void MOV_IdxMtoR_16(X86Register dest, uint16_t* base, X86Register index); // MOV dest, word [base + index * 2]
+	void MOV_ImmtoIdxM_32(uint32_t* base, X86Register index, uint32_t immediate); // MOV dword [base + index * 4], immediate
+	void MOV_IdxMtoR_32(X86Register dest, uint32_t* base, X86Register index); // MOV dest, dword [base + index * 4]
+	void MOV_IdxMtoR_8(X86Register dest, uint8_t* base, X86Register index); // MOV dest, byte [base + index]
+	void CMOVE_RwithR_32(X86Register dest, X86Register source); // Moves source into dest only if ZF = 1
+	void CMOVNE_RwithR_32(X86Register dest, X86Register source); // Moves source into dest only if ZF = 0
+	void SETC_R_8(X86Register dest); // dest = 1 if CF = 1, otherwise 0
+	void SETNC_R_8(X86Register dest); // dest = 1 if CF = 0, otherwise 0
 
 	void ADD_ImmtoR_8(X86Register dest, uint8_t immediate);
 	void ADD_ImmtoM_8(uint8_t* dest, uint8_t immediate);
@@ -60,42 +91,73 @@ public:
 
 	void SUB_ImmfromR_8(X86Register dest, uint8_t immediate);
 	void SUB_MfromR_8(X86Register dest, uint8_t* source);
+	void SUB_RfromR_8(X86Register dest, X86Register source);
 
 	void CMP_RwithImm_8(X86Register dest, uint8_t immediate);
 	void CMP_RwithR_8(X86Register dest, X86Register source);
 	void CMP_RwithImm_32(X86Register dest, uint32_t immediate);
+	void CMP_RwithIdxM_32(X86Register dest, uint32_t* base, X86Register index); // CMP dest, dword [base + index * 4]
 
 	void OR_RwithM_8(X86Register dest, uint8_t* source);
 	void AND_RwithM_8(X86Register dest, uint8_t* source);
 	void XOR_RwithM_8(X86Register dest, uint8_t* source);
+	void OR_RwithR_8(X86Register dest, X86Register source);
+	void AND_RwithR_8(X86Register dest, X86Register source);
 	void XOR_RwithR_32(X86Register dest, X86Register source);
 	void XOR_RwithR_8(X86Register dest, X86Register source);
+	void XOR_RtoIdxM_8(uint8_t* base, X86Register index, X86Register source); // XOR byte [base + index], source
+	void OR_RwithPTR_32(X86Register dest, X86Register PTR_source, int8_t displacement);
+	void AND_RwithImm_32(X86Register dest, uint32_t immediate);
+	void TEST_RwithR_32(X86Register dest, X86Register source);
 
 	void JE_32(int32_t relative); // near jump
 	void JNE_32(int32_t relative); // near jump
+	void JE_8(int8_t relative);
+	void JC_8(int8_t relative);
 	void JNG_8(int8_t relative);
 	void JNC_8(int8_t relative);
 	void JNE_8(int8_t relative);
 
+	// LABEL FUNCTIONS
+	// Forward jumps to the code of a C8 PC that has not been translated yet in the current block. The relative value is filled in once, when the label is bound.
+	void JE_Label(uint16_t c8_label, bool short_jump); // short_jump uses a rel8 encoding, only allowed when the caller knows the code in between is less than 128 bytes.
+	void JNE_Label(uint16_t c8_label, bool short_jump);
+	void bindLabelByC8PC(uint16_t c8_pc); // Binds the label to the current x86 address and resolves all of its fixups.
+	void bindAllLabels(); // Binds all outstanding labels to the current x86 address (end of block).
+	uint32_t getUnboundLabelCount();
+
+	void JMP_32(int32_t relative); // near jump
 	void JMP_M_PTR_32(uint32_t * address);
+	void JMP_IdxM_PTR_32(uint32_t * base, X86Register index); // JMP dword [base + index * 4]
+	void JMP_R_32(X86Register reg);
 
 	void SHL_R_8(X86Register reg, uint8_t count);
 	void SHR_R_8(X86Register reg, uint8_t count);
 	void SHR_R_32(X86Register reg, uint8_t count);
+	void SHR_R_16_CL(X86Register reg); // SHR reg, cl
 
 	void MUL_RwithR_8(X86Register source);
 	void DIV_RwithR_8(X86Register source);
 
 	void CALL_M_PTR_32(uint32_t * ptr_address); // CALL opcode
 	void RET(); // RET opcode
+	void NOP(uint8_t count); // count bytes of NOPs, using the multi-byte forms
 
 	void POP(X86Register reg); // POP opcode
 	void PUSH(X86Register reg); // PUSH opcode
+	void PUSH_Imm32(uint32_t immediate); // PUSH opcode
 
 	void RDTSC(); // Read time-stamp counter into EDX:EAX (used for random numbers).
 
 private:
+	FastArrayList<X86_LABEL_FIXUP> * label_fixup_list;
+
+	void recordLabelFixup(uint16_t c8_label, uint8_t fixup_sz); // Call straight after emitting the jump, the relative value is the last fixup_sz bytes.
+	void resolveLabelFixupByIndex(int32_t index);
+
 	// Misc opcode functions
 	// Helper function for ModRegRM byte of opcodes.
 	inline uint8_t ModRegRM(uint8_t mod, X86Register reg, X86Register rm);
+	// Helper function for SIB byte of opcodes (scale is the power of 2 to multiply index by).
+	inline uint8_t SIB(uint8_t scale, X86Register index, X86Register base);
 };
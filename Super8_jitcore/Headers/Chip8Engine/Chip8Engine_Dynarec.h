@@ -3,6 +3,15 @@
 #include <string>
 
 #include "Headers\Logger\ILogComponent.h"
+#include "Headers\Chip8Engine\Chip8Engine_CodeEmitter_x86.h"
+#include "Headers\Chip8Engine\Chip8Engine_IR.h"
+
+#define SUPERBLOCK_MAX_OPCODES 64 // Jumps and calls are only followed while the translator loop has translated fewer opcodes than this.
+#define SUPERBLOCK_MAX_JUMP_GAP 0x20 // Furthest (in C8 bytes) a 0x1NNN jump is followed forwards. The opcodes jumped over become part of the cache range.
+#define SUPERBLOCK_MAX_INLINE_OPCODES 6 // Longest subroutine (not counting the 0x00EE) which is inlined at a 0x2NNN call.
+#define SUPERBLOCK_INLINE_OPCODE_X86_SZ 0x80 // Upper bound of the code for each inlined opcode, they are all ones which pass isShortSkip().
+#define LOOP_HEAD_MAX_SCAN 0x40 // Furthest (in C8 bytes) ahead of an opcode that isLoopHead looks for a jump back to it.
+#define LOOP_HEAD_X86_ALIGNMENT 16 // Loop heads are padded to this, caches start on a code arena block so are always aligned.
 
 class Chip8Engine_Dynarec : ILogComponent
 {
@@ -13,21 +22,49 @@ public:
 	std::string getComponentName();
 
 	void emulateTranslatorCycle();
+	bool isLoopHead(uint16_t c8_pc); // True if a short backward 0x1NNN jump ahead of c8_pc (or an already translated jump) goes to c8_pc, so its code gets jumped into often.
+
+	// REGISTER ALLOCATION FUNCTIONS
+	// A block runs from one recorded opcode offset (start of translation, a loop head, a new cache or after a self modifying code check) to the next, and keeps its most used V registers in bl/bh.
+	// They are written back at every exit, interrupt and self modifying code check (see CodeEmitter_x86->DYNAREC_EMIT_REG_ALLOC_WRITE_BACK), so the rest of the emulator only ever sees C8_STATE::cpu.V.
+	// The opcodes inside a block get no x86 offset (OPCODE_X86_OFFSET_NONE), as the V registers are not in memory there, so they are never entry or truncation points.
+	void beginRegAllocBlock(); // Called by the translator for the first opcode of a block, after its offset is recorded. Picks the V registers by looking ahead and loads them.
+	void endRegAllocBlock(); // Writes back, after which all V registers are in memory.
 private:
+	bool isShortSkip(uint16_t c8_skipped_pc); // True if the code emitted for the opcode at c8_skipped_pc is always less than 128 bytes, so a skip over it can use a rel8 jump.
+
+	// IR FUNCTIONS (Chip8Engine_Dynarec_IR.cpp)
+	// Opcodes with an IR form are not emitted one at a time. The current one and the ones after it are decoded into an IR block, the IR passes are run over it, and then it is lowered to x86.
+	void translateIRBlock(); // Called for the current opcode instead of its handler. Leaves the C8 PC after the last opcode in the block.
+	void lowerIRBlock();
+	void lowerIRInstr(IR_INSTR * instr); // Everything except skips.
+	void lowerIRFlagResult(IR_INSTR * instr, X86Register x86_result, bool vf_is_carry); // Call straight after the x86 op of a flag op, stores Vx and (if IR_FLAG_VF_OUT is set) VF = CF or VF = !CF.
+	void lowerIRSkipCompare(IR_INSTR * instr, X86Register scratch_x, X86Register scratch_y); // Sets ZF to (Vx == imm/Vy), the jump (or CMOV) is left to the caller.
+	// A skip over a single register write (IR_LOAD_IMM -> IR_XOR) is lowered together with it as a CMOV instead of a jump.
+	bool canIfConvertIR(IR_INSTR * skipped);
+	void lowerIRIfConversion(IR_INSTR * skip, IR_INSTR * skipped); // Keeps the old Vx if the skip is taken.
+
+	// V REGISTER ACCESS FUNCTIONS
+	// Use the x86 register holding the V register in the current block, or memory if it is not allocated.
+	X86Register emitReadV(X86Register scratch, uint8_t c8_reg); // Returns the register holding the V register, loading it into scratch first if it is in memory.
+	void emitLoadV(X86Register dest, uint8_t c8_reg); // Always copies into dest, for when dest is changed afterwards.
+	void emitStoreV(uint8_t c8_reg, X86Register source); // No code if source is already the register holding it.
+	void emitStoreVImm(uint8_t c8_reg, uint8_t num);
+	void emitRegAllocExit(); // Writes back before an exit from the block (jump, call, return or indirect jump).
+
+	// SUPERBLOCK FUNCTIONS
+	// Instead of ending the block, the translator carries on at the target of a 0x1NNN jump or inside a 0x2NNN subroutine, so the code runs without leaving the cache.
+	bool canFollowJump(uint16_t c8_jump_pc); // Only short forward jumps, so the cache still covers one C8 range (the opcodes jumped over are included).
+	bool canInlineSubroutine(uint16_t c8_sub_pc); // Only small leaf subroutines. They are translated in place of the call, without using the C8 stack.
+
 	// MSN = most significant nibble (half-byte)
+	// Opcodes with an IR form do not have a handler (see translateIRBlock), so there are none for 0x3 -> 0x7, 0xA and 0xC.
 	void handleOpcodeMSN_0();
 	void handleOpcodeMSN_1();
 	void handleOpcodeMSN_2();
-	void handleOpcodeMSN_3();
-	void handleOpcodeMSN_4();
-	void handleOpcodeMSN_5();
-	void handleOpcodeMSN_6();
-	void handleOpcodeMSN_7();
 	void handleOpcodeMSN_8();
 	void handleOpcodeMSN_9();
-	void handleOpcodeMSN_A();
 	void handleOpcodeMSN_B();
-	void handleOpcodeMSN_C();
 	void handleOpcodeMSN_D();
 	void handleOpcodeMSN_E();
 	void handleOpcodeMSN_F();
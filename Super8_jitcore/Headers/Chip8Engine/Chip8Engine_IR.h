@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Headers\Globals.h"
+
+#define IR_MAX_BLOCK_INSTRS 32 // Longest run of opcodes decoded into one IR block.
+#define IR_MAX_PASSES 8
+#define IR_INSTR_X86_SZ 0x50 // Upper bound of the code lowered for one IR instruction (0xFX65 with the V register write backs/loads is the largest). An opcode is only added to a block while there is room for all of them.
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The IR is a small typed form of the CHIP-8 opcodes which only change the V/I registers or      //
+// skip. Instead of emitting each opcode as it is reached, the dynarec decodes a run of them into //
+// an IR block, runs the registered passes over the whole block, and then lowers it to x86 (see   //
+// Chip8Engine_Dynarec::translateIRBlock). Opcodes which leave the block (jumps, calls, returns),  //
+// call helpers or write C8 memory (self modifying code checks) are still emitted directly, and   //
+// end the run.                                                                                   //
+//                                                                                                //
+// Passes may change instructions or turn them into IR_NOP, but never add or reorder them, so     //
+// instrs[i] always stays the opcode at c8_start_pc + i * 2 (the skips rely on this).             //
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum IR_OP : uint8_t {
+	IR_NOP, // Removed by a pass, no code.
+	// V register ops: Vx is written, Vy is read.
+	IR_LOAD_IMM, // Vx = imm, and VF = y with IR_FLAG_VF_OUT (a flag op folded by passConstantFolding)
+	IR_ADD_IMM, // Vx += imm, VF is not changed
+	IR_MOV, // Vx = Vy
+	IR_OR, // Vx |= Vy
+	IR_AND, // Vx &= Vy
+	IR_XOR, // Vx ^= Vy
+	IR_ADD, // Vx += Vy, carry out
+	IR_SUB, // Vx -= Vy, not borrow out
+	IR_SUBN, // Vx = Vy - Vx, not borrow out
+	IR_SHR, // Vx >>= 1, LSB out
+	IR_SHL, // Vx <<= 1, MSB out
+	IR_RAND, // Vx = random & imm
+	// I register and memory ops
+	IR_SET_I, // I = imm
+	IR_ADD_I, // I += Vx
+	IR_FONT_I, // I = Vx * 5
+	IR_LOAD_MEM, // V0 -> Vx = memory[I -> I + x]
+	// Skips over the next opcode
+	IR_SKIP_EQ_IMM, // if (Vx == imm)
+	IR_SKIP_NE_IMM, // if (Vx != imm)
+	IR_SKIP_EQ, // if (Vx == Vy)
+	IR_SKIP_NE // if (Vx != Vy)
+};
+
+#define IR_FLAG_VF_OUT 0x01 // The instruction sets VF to its carry/borrow/shifted out bit. Only valid on IR_ADD -> IR_SHL and IR_LOAD_IMM.
+
+struct IR_INSTR {
+	IR_OP op;
+	uint8_t x; // Vx
+	uint8_t y; // Vy
+	uint8_t flags;
+	uint16_t imm; // NN or NNN from the opcode.
+	uint16_t c8_pc; // Opcode this was decoded from.
+};
+
+struct IR_BLOCK {
+	IR_INSTR instrs[IR_MAX_BLOCK_INSTRS];
+	uint8_t count;
+	uint16_t c8_start_pc;
+};
+
+typedef void (*IR_PASS_FUNC)(IR_BLOCK * block);
+
+struct IR_PASS {
+	const char * name;
+	IR_PASS_FUNC func;
+	uint64_t ticks; // Performance counter ticks spent in the pass, over all runs (only with USE_IR_PASS_TIMING).
+	uint32_t runs;
+};
+
+class Chip8Engine_IR : ILogComponent
+{
+public:
+	Chip8Engine_IR();
+	~Chip8Engine_IR();
+
+	std::string getComponentName();
+
+	IR_BLOCK block; // The block being translated.
+
+	void beginBlock(uint16_t c8_start_pc);
+	bool decodeOpcode(uint16_t c8_opcode); // Appends the IR form of the opcode to the block. Returns false (and appends nothing) if it has none or the block is full.
+	static bool hasIRForm(uint16_t c8_opcode);
+	static bool isSkipOp(IR_OP op);
+
+	void registerPass(const char * name, IR_PASS_FUNC func); // Passes run in the order they are registered.
+	void runPasses();
+
+	// PASSES (Chip8Engine_IR_Passes.cpp)
+	// Values are only known inside the block, every V register and I are unknown at the start and still in use at the end.
+	static void passConstantFolding(IR_BLOCK * block); // Works out V/I values known at translate time, turns instructions with known inputs into IR_LOAD_IMM/IR_SET_I and removes skips with a known outcome.
+	static void passDeadFlags(IR_BLOCK * block); // Clears IR_FLAG_VF_OUT where VF is overwritten before it is read, so the flag is not worked out.
+	static void passDeadStores(IR_BLOCK * block); // Removes register writes which are overwritten before they are read.
+
+#ifdef USE_DEBUG
+	void DEBUG_printBlock();
+#endif
+#ifdef USE_IR_PASS_TIMING
+	void DEBUG_printPassTimes();
+#endif
+
+private:
+	static bool getRegMasks(IR_INSTR * instr, uint32_t * reads, uint32_t * writes); // Registers (V0 -> VF, then I) the instruction reads and writes. Returns false if it does anything else (so can not be removed).
+
+	IR_PASS passes[IR_MAX_PASSES];
+	uint8_t num_passes;
+};
\ No newline at end of file
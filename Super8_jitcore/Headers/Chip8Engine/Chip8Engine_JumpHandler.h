@@ -4,6 +4,8 @@
 
 #include "Headers\Globals.h"
 #include "Headers\FastArrayList\FastArrayList.h"
+#include "Headers\Chip8Globals\Chip8Globals_C8_STATE.h"
+#include "Headers\Chip8Engine\Chip8Engine_CacheHandler.h"
 
 
 struct JUMP_ENTRY {
@@ -11,11 +13,17 @@ struct JUMP_ENTRY {
 	uint8_t * x86_address_to; // JMP_M_PTR_32 uses this value
 };
 
-struct COND_JUMP_ENTRY {
-	uint16_t c8_address_from; // not used except for debug?
-	uint16_t c8_address_to; // not used except for debug?
-	uint32_t * x86_address_jump_value; // Contains absolute cache address pointing to the relative jump value (which will need to be filled in)
-	uint8_t translator_cycles;
+#define JUMP_LINK_SZ 5 // Size of the JMP rel32 which is patched over the start of the jump interrupt.
+
+struct JUMP_LINK_ENTRY {
+	uint16_t c8_address_to;
+	uint8_t * x86_address_link; // Start of the PREPARE_FOR_JUMP interrupt emitted for this jump, which gets overwritten with a direct JMP rel32 to the target cache.
+	uint8_t x86_original_bytes[JUMP_LINK_SZ]; // Original interrupt bytes, restored when the jump is unlinked.
+	uint8_t linked;
+	int32_t cache_index_from; // Cache containing x86_address_link.
+	int32_t next_link_to; // Next/previous link with the same c8_address_to (list starts at jump_link_head_to), -1 if none.
+	int32_t prev_link_to;
+	int32_t next_link_from; // Next link inside the same cache (list starts at jump_link_head_from), -1 if none.
 };
 
 class Chip8Engine_JumpHandler : ILogComponent
@@ -23,7 +31,11 @@ class Chip8Engine_JumpHandler : ILogComponent
 public:
 	FastArrayList<int32_t> * jump_fill_list;
 	FastArrayList<JUMP_ENTRY> * jump_list;
-	FastArrayList<COND_JUMP_ENTRY> * cond_jump_list;
+	FastArrayList<JUMP_LINK_ENTRY> * jump_link_list; // Indexes are stable: a removed link leaves an empty slot (x86_address_link == NULL) which is reused by the next link.
+	FastArrayList<int32_t> * jump_link_free_slot_list;
+	int32_t jump_index_by_c8pc[MEMORY_SZ]; // Index into jump_list of the jump entry for each C8 PC, -1 if none.
+	int32_t jump_link_head_to[MEMORY_SZ]; // First link jumping to each C8 PC (see JUMP_LINK_ENTRY::next_link_to), -1 if none.
+	int32_t jump_link_head_from[MAX_NUM_CACHES]; // First link inside each cache (see JUMP_LINK_ENTRY::next_link_from), -1 if none.
 	uint8_t * x86_indirect_jump_address; // USED ONLY FOR INDIRECT JUMPS! (as address to jump to might change, but we have already emitted a jump.. This is the easiest way to update the jump location).
 
 	Chip8Engine_JumpHandler();
@@ -35,16 +47,17 @@ public:
 	JUMP_ENTRY * getJumpInfoByIndex(uint32_t index);
 	void clearFilledFlagByC8PC(uint16_t c8_pc);
 
-	int32_t recordConditionalJumpEntry(uint16_t c8_from_, uint16_t c8_to_, uint8_t translator_cycles_, uint32_t * x86_address_jump_value_);
-	void decreaseConditionalCycle();
-	uint8_t checkConditionalCycle();
+	// BLOCK LINKING FUNCTIONS
+	int32_t recordJumpLinkEntry(uint16_t c8_to_, uint8_t * x86_address_link_); // Call after the jump has been emitted. Links straight away if the target cache is already known.
+	void linkJumpsByC8PC(uint16_t c8_to, uint8_t * x86_address_to);
+	void unlinkJumpsByC8PC(uint16_t c8_to);
+	void removeJumpLinksByCacheIndex(int32_t cache_index, uint8_t * x86_from); // Removes the links inside the cache at or after x86_from. Used when a cache is freed or truncated, as the link sites no longer exist.
 
 	void checkAndFillJumpsByStartC8PC();
-	void checkAndFillConditionalJumpsByCycles();
 
 #ifdef USE_DEBUG_EXTRA
 	void DEBUG_printJumpList();
-	void DEBUG_printCondJumpList();
+	void DEBUG_printJumpLinkList();
 #endif
 
 private:
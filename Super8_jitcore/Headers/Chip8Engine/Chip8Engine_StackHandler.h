@@ -6,6 +6,7 @@
 #include "Headers\Globals.h"
 
 #define NUM_STACK_LVLS 16
+#define STACK_NO_GENERATION 0xFFFFFFFF // Used when there is no x86 return address prediction (never matches a cache generation).
 
 struct STACK_ENTRY {
 	uint16_t c8_address;
@@ -15,6 +16,10 @@ class Chip8Engine_StackHandler : ILogComponent
 {
 public:
 	uint8_t * x86_address_to;
+	STACK_ENTRY stack[NUM_STACK_LVLS]; // Stack used in the implementation, supports 16 levels. Pushed/popped directly by emitted code for 0x2NNN/0x00EE (see Dynarec).
+	uint8_t sp; // Stack pointer
+	uint8_t * x86_return_address[NUM_STACK_LVLS]; // Predicted x86 address to return to for each stack level (start of the cache at the return C8 PC when the call was translated).
+	uint32_t x86_return_generation[NUM_STACK_LVLS]; // CacheHandler::cache_start_generation of the return C8 PC when the call was translated. The prediction is only used if this still matches.
 
 	Chip8Engine_StackHandler();
 	~Chip8Engine_StackHandler();
@@ -28,8 +33,4 @@ public:
 #ifdef USE_DEBUG_EXTRA
 	void DEBUG_printStack();
 #endif
-
-private:
-	STACK_ENTRY stack[NUM_STACK_LVLS]; // Stack used in the implementation, supports 16 levels.
-	uint8_t sp; // Stack pointer
 };
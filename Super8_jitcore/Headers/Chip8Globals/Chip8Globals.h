@@ -10,6 +10,7 @@
 class Chip8Engine_JumpHandler;
 class Chip8Engine_Interpreter;
 class Chip8Engine_Dynarec;
+class Chip8Engine_IR;
 class Chip8Engine_Timers;
 class Chip8Engine_CodeEmitter_x86;
 class Chip8Engine_CacheHandler;
@@ -24,6 +25,7 @@ namespace Chip8Globals {
 	extern Chip8Engine_Interpreter * interpreter;
 	extern Chip8Engine_StackHandler * stack;
 	extern Chip8Engine_Dynarec * dynarec;
+	extern Chip8Engine_IR * ir;
 	extern Chip8Engine_CacheHandler * cache;
 	extern Chip8Engine_JumpHandler * jumptbl;
 	extern Chip8Engine_CodeEmitter_x86 * emitter;
@@ -5,9 +5,10 @@
 #define NUM_BITS_PER_BYTE 8
 #define NUM_V_REG 16 // 16 8-bit data registers from V0 -> VF
 #define MEMORY_SZ 4096 // 4K of RAM (0x0000 -> 0x0FFF accessable)
-#define GFX_MEMORY_SZ 2048 // 2K of VRAM (64 x 32)
 #define GFX_XRES 64
 #define GFX_YRES 32
+#define GFX_ROW_SZ (GFX_XRES / NUM_BITS_PER_BYTE) // 8 bytes per row, 1 bit per pixel. The leftmost pixel of a byte is its MSB (same as sprite data).
+#define GFX_MEMORY_SZ (GFX_ROW_SZ * GFX_YRES) // 256 bytes of VRAM (64 x 32 pixels)
 
 struct C8_CPU {
 	uint16_t pc; // 16-bit wide program counter, contains current address being executed
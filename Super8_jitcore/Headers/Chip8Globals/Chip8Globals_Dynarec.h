@@ -1,7 +1,19 @@
 #pragma once
 
+#include <cstdint>
+
+#define NO_INLINE_RETURN 0xFFFF
+#define REG_ALLOC_MAX_REGS 2 // V registers are kept in bl and bh, the only 8-bit registers which the emitted code doesn't use as scratch and helpers (cdecl) don't clobber.
+#define REG_ALLOC_MIN_USES 3 // A V register is only kept in a register if the block uses it at least this many times, otherwise the load and write backs cost more than they save.
+#define REG_ALLOC_MOV_X86_SZ 6 // Size of each load/write back (MOV r8, m8 or MOV m8, r8).
+
 namespace Chip8Globals {
 	namespace Dynarec {
 		extern bool block_finished;
+		extern uint32_t block_opcode_count; // Opcodes translated so far in the current translator loop (superblock budget).
+		extern uint16_t inline_return_pc; // C8 PC to carry on from when the subroutine being inlined returns, NO_INLINE_RETURN if not inlining.
+		extern bool reg_alloc_block_start; // Set when the next translated opcode starts a new register allocation block (see Chip8Engine_Dynarec::beginRegAllocBlock).
+		extern uint8_t reg_alloc_count; // Number of V registers held in x86 registers in the current block, 0 if they are all in memory.
+		extern uint8_t reg_alloc_c8_reg[REG_ALLOC_MAX_REGS]; // V register held in bl (index 0) and bh (index 1).
 	}
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+// Calling convention used between emitted code and the helpers (cdecl): the argument is pushed on the stack and popped by the caller,
+// the result is returned in eax, and eax, ecx & edx may be changed by the helper. Emitted code never keeps values in those registers across a helper call.
+#ifdef _MSC_VER
+#define X86_HELPER_CALL __cdecl
+#else
+#define X86_HELPER_CALL __attribute__((cdecl))
+#endif
+
+namespace Chip8Globals {
+	namespace X86_HELPERS {
+		// Helpers for opcodes which have side effects but do not change control flow. They are called straight from the emitted code (see CodeEmitter::DYNAREC_EMIT_HELPER_CALL),
+		// instead of exiting to the dispatcher loop. Returns non-zero if the emitted code should still exit, so the main loop can draw the screen and poll events.
+		typedef uint32_t (X86_HELPER_CALL * X86_HELPER_FUNC)(uint32_t c8_opcode);
+
+		// The emitted code calls through these (CALL dword [ptr]), so the address of the helper is not baked into the cache.
+		extern X86_HELPER_FUNC x86_helper_USE_INTERPRETER;
+		extern X86_HELPER_FUNC x86_helper_DRAW;
+		extern X86_HELPER_FUNC x86_helper_WAIT_FOR_KEYPRESS;
+		extern X86_HELPER_FUNC x86_helper_UPDATE_TIMERS;
+
+		uint32_t X86_HELPER_CALL helper_USE_INTERPRETER(uint32_t c8_opcode); // 0x00E0.
+		uint32_t X86_HELPER_CALL helper_DRAW(uint32_t c8_opcode); // 0xDXYN, after the emitted code has drawn the sprite. Sets the draw flag and runs the speed limiter.
+		uint32_t X86_HELPER_CALL helper_WAIT_FOR_KEYPRESS(uint32_t c8_opcode); // 0xFX0A, puts the key pressed into key->X86_KEY_PRESSED.
+		uint32_t X86_HELPER_CALL helper_UPDATE_TIMERS(uint32_t c8_opcode); // 0xFX07, 0xFX15, 0xFX18.
+	}
+}
\ No newline at end of file
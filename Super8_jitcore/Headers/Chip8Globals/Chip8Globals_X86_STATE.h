@@ -2,6 +2,8 @@
 
 #include <cstdint>
 
+#define BACKWARD_JUMP_BUDGET 0x4000 // Number of linked backward 0x1NNN jumps taken before one exits to the main loop anyway (see Dynarec::handleOpcodeMSN_1).
+
 namespace Chip8Globals {
 	namespace X86_STATE {
 		// Status codes used in the x86 state
@@ -14,17 +16,19 @@ namespace Chip8Globals {
 			DEBUG = 5,
 			WAIT_FOR_KEYPRESS = 6,
 			PREPARE_FOR_STACK_JUMP = 7,
-			UPDATE_TIMERS = 8
+			UPDATE_TIMERS = 8,
+			DISPATCH_MISS = 9
 #ifdef LIMIT_SPEED_BY_INSTRUCTIONS
-			, DELAY_INSTRUCTION = 9
+			, DELAY_INSTRUCTION = 10
 #endif
 		};
 
 		extern uint8_t * x86_resume_address; // Used as the entry point into dynarec emulation.
-		extern uint16_t x86_interrupt_c8_param1; // Used with many interrupts.
+		extern uint16_t x86_interrupt_c8_param1; // Used with many interrupts. Also set by emitted code before a dispatch table jump (contains the C8 PC for DISPATCH_MISS).
 		extern uint16_t x86_interrupt_c8_param2; // Used with PREPARE_FOR_STACK_JUMP interrupts.
 		extern uint8_t * x86_interrupt_x86_param1; // Used with out of code interrupts (to determine which cache needs more code).
 		extern X86_INT_STATUS_CODE x86_interrupt_status_code; // Used by dispatcher loop to determine which type of interrupt happened.
+		extern uint16_t x86_backward_jump_budget; // Counted down by emitted backward 0x1NNN jumps, the jump exits to the main loop when it reaches 0.
 
 #ifdef USE_DEBUG
 		extern char * x86_int_status_code_strings[];
@@ -40,4 +40,8 @@
 #endif
 #endif
 
+// Profiling
+// Times each IR pass with the SDL performance counter (see Chip8Engine_IR::runPasses), and logs the totals on exit.
+//#define USE_IR_PASS_TIMING
+
 extern Logger * logger;
\ No newline at end of file
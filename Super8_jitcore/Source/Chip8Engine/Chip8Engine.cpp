@@ -16,6 +16,7 @@
 #include "Headers\Chip8Engine\Chip8Engine_CacheHandler.h"
 #include "Headers\Chip8Engine\Chip8Engine_CodeEmitter_x86.h"
 #include "Headers\Chip8Engine\Chip8Engine_Dynarec.h"
+#include "Headers\Chip8Engine\Chip8Engine_IR.h"
 #include "Headers\Chip8Engine\Chip8Engine_Interpreter.h"
 #include "Headers\Chip8Engine\Chip8Engine_JumpHandler.h"
 #include "Headers\Chip8Engine\Chip8Engine_Key.h"
@@ -25,12 +26,6 @@
 using namespace Chip8Globals;
 
 // Variables
-#ifdef LIMIT_SPEED_BY_DRAW_CALLS
-uint32_t old_ticks = 0;
-uint32_t new_ticks = 0;
-int32_t delta_ticks = 0;
-const uint32_t limiter_max_time_slice = (1000 / TARGET_FRAMES_PER_SECOND);
-#endif
 #ifdef LIMIT_SPEED_BY_INSTRUCTIONS
 const uint32_t limiter_delay_ms = (1000 / TARGET_CPU_SPEED_HZ);
 #endif
@@ -61,6 +56,7 @@ Chip8Engine::~Chip8Engine() {
 	delete timers;
 	delete interpreter;
 	delete dynarec;
+	delete ir;
 	delete emitter;
 	delete cache;
 	delete jumptbl;
@@ -78,6 +74,7 @@ void Chip8Engine::initialise() {
 	interpreter = new Chip8Engine_Interpreter();
 	emitter = new Chip8Engine_CodeEmitter_x86();
 	dynarec = new Chip8Engine_Dynarec();
+	ir = new Chip8Engine_IR();
 	cache = new Chip8Engine_CacheHandler();
 	stack = new Chip8Engine_StackHandler();
 	jumptbl = new Chip8Engine_JumpHandler();
@@ -91,9 +88,7 @@ void Chip8Engine::initialise() {
 	C8_STATE::opcode = (uint16_t)0x0000;				// Reset current opcode
 	C8_STATE::cpu.I = (uint16_t)0x000;					// Reset index register
 	stack->resetStack();								// Reset stack pointer
-#ifndef USE_SDL_GRAPHICS
 	C8_STATE::C8_clearGFXMem();							// Clear display
-#endif
 	C8_STATE::C8_clearRegV();							// Clear registers V0-VF
 	C8_STATE::C8_clearMem();							// Clear memory
 
@@ -160,8 +155,10 @@ void Chip8Engine::handleInterrupt()
 		break;
 	}
 	case X86_STATE::USE_INTERPRETER:
+	case X86_STATE::WAIT_FOR_KEYPRESS:
+	case X86_STATE::UPDATE_TIMERS:
 	{
-		handleInterrupt_USE_INTERPRETER();
+		// The opcode was already run by its helper (see Chip8Globals_X86_HELPERS), which only exited so the main loop can draw and poll events. Nothing left to do.
 		break;
 	}
 	case X86_STATE::OUT_OF_CODE:
@@ -186,19 +183,14 @@ void Chip8Engine::handleInterrupt()
 		break;
 	}
 #endif
-	case X86_STATE::WAIT_FOR_KEYPRESS:
-	{
-		handleInterrupt_WAIT_FOR_KEYPRESS();
-		break;
-	}
 	case X86_STATE::PREPARE_FOR_STACK_JUMP:
 	{
 		handleInterrupt_PREPARE_FOR_STACK_JUMP();
 		break;
 	}
-	case X86_STATE::UPDATE_TIMERS:
+	case X86_STATE::DISPATCH_MISS:
 	{
-		handleInterrupt_UPDATE_TIMERS();
+		handleInterrupt_DISPATCH_MISS();
 		break;
 	}
 #ifdef LIMIT_SPEED_BY_INSTRUCTIONS
@@ -220,6 +212,8 @@ void Chip8Engine::translatorLoop()
 {
 	// Set the loop condition to false first, which will become true when a jump is encountered and then break the loop.
 	Dynarec::block_finished = false;
+	Dynarec::block_opcode_count = 0;
+	Dynarec::reg_alloc_block_start = true;
 
 	// Translator loop.
 	while (Dynarec::block_finished == false) { // Limit a cache update to blocks of code.
@@ -244,6 +238,43 @@ void Chip8Engine::translatorLoop()
 			break;
 		}
 
+		// Resolve any skips (conditional jumps) over the previous opcode, which land on the code of this one.
+		emitter->bindLabelByC8PC(C8_STATE::cpu.pc);
+
+		// Loop heads get jumped into, so they start a new register allocation block (opcodes inside one are not entry points). Not while a skip over this opcode is unbound, as the skip would miss the write back.
+		// The write back for a block which ends here comes after the skips into this opcode are bound, so they go through it as well.
+		bool loop_head = (Dynarec::inline_return_pc == NO_INLINE_RETURN && dynarec->isLoopHead(C8_STATE::cpu.pc));
+		if (loop_head && emitter->getUnboundLabelCount() == 0) Dynarec::reg_alloc_block_start = true;
+		if (Dynarec::reg_alloc_block_start) dynarec->endRegAllocBlock();
+
+		// Continue in a new cache if the next opcode might not fit. Not done while a skip is still unbound, as its target is the code of an opcode still to be translated, or while inlining a subroutine (it was checked to fit).
+		// As there is no check between a skip and the opcode it skips, a skip needs room for both.
+		uint16_t c8_next_opcode = C8_STATE::memory[C8_STATE::cpu.pc] << 8 | C8_STATE::memory[C8_STATE::cpu.pc + 1];
+		uint32_t x86_space_needed = cache->isSkipOpcode(c8_next_opcode) ? MAX_OPCODE_X86_SZ * 2 : MAX_OPCODE_X86_SZ;
+		if (cache->getFreeX86SpaceCurrent() < x86_space_needed && emitter->getUnboundLabelCount() == 0 && Dynarec::inline_return_pc == NO_INLINE_RETURN) {
+			translatorChainCache();
+			if (Dynarec::block_finished) {
+				translate_cycles++;
+				break;
+			}
+		}
+
+		// Start loop heads on a new 16 byte line, so a dense loop takes up as few i-cache lines as possible. Inlined subroutines have no loops.
+		if (loop_head) emitter->DYNAREC_EMIT_ALIGN(LOOP_HEAD_X86_ALIGNMENT);
+
+		// Remember where the code for this opcode starts, so the cache can be truncated here later (see CacheHandler::truncateCacheByIndex).
+		// Only the first opcode of a register allocation block has all V registers in memory, the rest are recorded as having no offset.
+		if (Dynarec::reg_alloc_block_start) {
+			cache->recordOpcodeX86OffsetCurrent(C8_STATE::cpu.pc);
+			dynarec->beginRegAllocBlock();
+		}
+		else if (Dynarec::reg_alloc_count > 0) {
+			cache->recordOpcodeX86OffsetNoneCurrent(C8_STATE::cpu.pc);
+		}
+		else {
+			cache->recordOpcodeX86OffsetCurrent(C8_STATE::cpu.pc);
+		}
+
 		// Fetch Opcode
 		C8_STATE::opcode = C8_STATE::memory[C8_STATE::cpu.pc] << 8 | C8_STATE::memory[C8_STATE::cpu.pc + 1]; // We have 8-bit memory, but an opcode is 16-bits long. Need to construct opcode from 2 successive memory locations.
 
@@ -257,10 +288,6 @@ void Chip8Engine::translatorLoop()
 		// Translate
 		dynarec->emulateTranslatorCycle();
 
-		// Check and fill in conditional jumps & decrease num of cycles
-		jumptbl->decreaseConditionalCycle();
-		jumptbl->checkAndFillConditionalJumpsByCycles();
-
 		// Delay instruction by 1000/TARGET_CPU_SPEED_HZ if limiter option is on.
 #ifdef LIMIT_SPEED_BY_INSTRUCTIONS
 		emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::DELAY_INSTRUCTION);
@@ -268,7 +295,43 @@ void Chip8Engine::translatorLoop()
 
 		// Update cycle number
 		translate_cycles++;
+		Dynarec::block_opcode_count++;
 	} 
+
+	// Make sure running off the end of the block exits to the dynarec (ie: a conditional jump over the last opcode). Skips which were not reached land on the exit jump.
+	emitter->bindAllLabels();
+	dynarec->endRegAllocBlock();
+	cache->writeExitJumpCurrent();
+}
+
+void Chip8Engine::translatorChainCache()
+{
+	// Seal the full cache with a jump to the current C8 PC, the same as a 0x1NNN jump (goes through the jump table until it is linked).
+	uint16_t c8_continue_pc = C8_STATE::cpu.pc;
+	int32_t full_cache_index = cache->findCacheIndexCurrent();
+	int32_t tblindex = jumptbl->getJumpIndexByC8PC(c8_continue_pc);
+	dynarec->endRegAllocBlock();
+	uint8_t * x86_address_link = cache->getEndX86AddressCurrent();
+	emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::PREPARE_FOR_JUMP, c8_continue_pc);
+	emitter->JMP_M_PTR_32((uint32_t*)&jumptbl->getJumpInfoByIndex(tblindex)->x86_address_to);
+	jumptbl->recordJumpLinkEntry(c8_continue_pc, x86_address_link);
+
+	// The continuation cache starts a new register allocation block.
+	Dynarec::reg_alloc_block_start = true;
+
+	// Get the continuation cache and keep translating into it. If it already has code (some other jump starts there), this block is done.
+	int32_t cache_index = cache->getCacheWritableByStartC8PC(c8_continue_pc);
+	cache->setContinuationByIndex(full_cache_index, cache_index);
+#ifdef USE_VERBOSE
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Cache[%d] full, continuing in cache[%d] at C8 PC = 0x%.4X.", full_cache_index, cache_index, c8_continue_pc);
+	logMessage(LOGLEVEL::L_INFO, buffer);
+#endif
+	if (cache->getCacheInfoByIndex(cache_index)->x86_pc != 0) {
+		Dynarec::block_finished = true;
+		return;
+	}
+	cache->switchCacheByIndex(cache_index);
 }
 
 void Chip8Engine::handleInterrupt_PREPARE_FOR_JUMP()
@@ -284,23 +347,6 @@ void Chip8Engine::handleInterrupt_PREPARE_FOR_JUMP()
 	jumptbl->checkAndFillJumpsByStartC8PC();
 }
 
-void Chip8Engine::handleInterrupt_USE_INTERPRETER()
-{
-	// ! ! ! X86_STATE::x86_interrupt_c8_param1 contains interpreter opcode ! ! !
-
-	// Opcode hasnt been implemented in the dynarec yet, need to use interpreter
-	interpreter->setOpcode(X86_STATE::x86_interrupt_c8_param1);
-	interpreter->emulateCycle();
-
-#ifdef LIMIT_SPEED_BY_DRAW_CALLS
-	// If defined, attempts to delay emulation by ((uint)1000/TARGET_FRAMES_PER_SECOND - execution time since last draw call)ms.
-	new_ticks = SDL_GetTicks();
-	delta_ticks = limiter_max_time_slice - (new_ticks - old_ticks);
-	if (delta_ticks > 0) SDL_Delay(delta_ticks);
-	old_ticks = SDL_GetTicks();
-#endif
-}
-
 void Chip8Engine::handleInterrupt_OUT_OF_CODE()
 {
 	// ! ! ! X86_STATE::x86_interrupt_c8_param1 contains start pc of cache, X86_STATE::x86_interrupt_x86_param1 contains starting x86 address of cache ! ! !
@@ -320,13 +366,27 @@ void Chip8Engine::handleInterrupt_OUT_OF_CODE()
 		C8_STATE::cpu.pc = region->c8_start_recompile_pc;
 		translatorLoop();
 	}
-	// Case 2 - cache has code, but needs a jump needs to happen into the next cache (end pc + 2). This is due to a conditional jump.
+	// Case 2 - cache was truncated by self modifying code, so continue recompiling from where it was cut off (the resume address is the truncation stub, which gets overwritten).
+	else if (region->truncated_flag) {
+		region->truncated_flag = 0;
+		C8_STATE::cpu.pc = region->c8_end_recompile_pc + 2;
+		translatorLoop();
+	}
+	// Case 3 - cache has code, but needs a jump needs to happen into the next cache (end pc + 2). This is due to a conditional jump.
+	// If the jump doesn't fit (the last opcode used up the cache), nothing is emitted and this exit keeps going through here to the cache for end pc + 2.
+	else if (cache->getFreeX86SpaceCurrent() < DYNAREC_INTERRUPT_X86_SZ + JMP_M_PTR_32_X86_SZ) {
+		int32_t next_cache_index = cache->getCacheWritableByStartC8PC(region->c8_end_recompile_pc + 2);
+		X86_STATE::x86_resume_address = cache->getEntryX86AddressByIndex(next_cache_index, region->c8_end_recompile_pc + 2);
+	}
 	else {
 		// First make sure jump table entry
 		int32_t tblindex = jumptbl->getJumpIndexByC8PC(region->c8_end_recompile_pc + 2);
 		// Emit the jump
+		uint8_t * x86_address_link = cache->getEndX86AddressCurrent();
 		emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::PREPARE_FOR_JUMP, region->c8_end_recompile_pc + 2);
 		emitter->JMP_M_PTR_32((uint32_t*)&jumptbl->getJumpInfoByIndex(tblindex)->x86_address_to);
+		jumptbl->recordJumpLinkEntry(region->c8_end_recompile_pc + 2, x86_address_link);
+		cache->writeExitJumpCurrent();
 	}
 }
 
@@ -346,8 +406,7 @@ void Chip8Engine::handleInterrupt_PREPARE_FOR_INDIRECT_JUMP()
 
 										  // Jump cache handling done by CacheHandler, so this function just updates the jump table locations
 		int32_t cache_index = cache->getCacheWritableByStartC8PC(c8_address);
-		CACHE_REGION * region = cache->getCacheInfoByIndex(cache_index);
-		jumptbl->x86_indirect_jump_address = region->x86_mem_address;
+		jumptbl->x86_indirect_jump_address = cache->getEntryX86AddressByIndex(cache_index, c8_address);
 	}
 	default:
 	{
@@ -366,19 +425,14 @@ void Chip8Engine::handleInterrupt_SELF_MODIFYING_CODE()
 	{
 		// 0xFX33: Splits the decimal representation of Vx into 3 locations: hundreds stored in address I, tens in address I+1, and ones in I+2.
 		//cache->DEBUG_printCacheList();
-		//uint16_t I = C8_STATE::cpu.I;
-		cache->setInvalidFlagByC8PC(C8_STATE::cpu.I);
-		cache->setInvalidFlagByC8PC(C8_STATE::cpu.I + 1);
-		cache->setInvalidFlagByC8PC(C8_STATE::cpu.I + 2);
+		cache->invalidateRange(C8_STATE::cpu.I, 3);
 		break;
 	}
 	case 0xF055:
 	{
 		// 0xFX55: Copies all current values in registers V0 -> Vx to memory starting at address I.
 		uint8_t vx = (X86_STATE::x86_interrupt_c8_param1 & 0x0F00) >> 8; // Need to bit shift by 8 to get to a single base16 digit.
-		for (uint8_t i = 0; i <= vx; i++) {
-			cache->setInvalidFlagByC8PC(C8_STATE::cpu.I + i);
-		}
+		cache->invalidateRange(C8_STATE::cpu.I, vx + 1);
 		break;
 	}
 	}
@@ -394,26 +448,9 @@ void Chip8Engine::handleInterrupt_DEBUG()
 	//X86_STATE::DEBUG_printX86_STATE();
 	//cache->DEBUG_printCacheList();
 	//jumptbl->DEBUG_printJumpList();
-	//jumptbl->DEBUG_printCondJumpList();
 }
 #endif
 
-void Chip8Engine::handleInterrupt_WAIT_FOR_KEYPRESS()
-{
-	// ! ! ! X86_STATE::x86_interrupt_c8_param1 contains the C8 opcode ! ! !
-	// Only one opcode: 0xFX0A: A key press is awaited, then stored in Vx.
-	// For now this will do, however it should be handled by the parent object to the C8Engine
-	// Check if there has been a key press, and if so, store it in key->x86_key_pressed
-	uint8_t keystate = 0;
-	for (int i = 0; i < NUM_KEYS; i++) {
-		keystate = key->getKeyState(i); // Get the keystate from the key object.
-		if (keystate == 1) {
-			key->X86_KEY_PRESSED = i; // Set Vx to the key pressed (0x0 -> 0xF). See dynarec
-			break;
-		}
-	}
-}
-
 void Chip8Engine::handleInterrupt_PREPARE_FOR_STACK_JUMP()
 {
 	// ! ! ! X86_STATE::x86_interrupt_c8_param1 contains either: 0x2NNN (call, address = NNN) or 0x00EE (ret), X86_STATE::x86_interrupt_c8_param2 contains the return address for an 0x2000 call ! ! !
@@ -465,46 +502,17 @@ void Chip8Engine::handleInterrupt_PREPARE_FOR_STACK_JUMP()
 	}
 }
 
-void Chip8Engine::handleInterrupt_UPDATE_TIMERS()
+void Chip8Engine::handleInterrupt_DISPATCH_MISS()
 {
-	switch (X86_STATE::x86_interrupt_c8_param1 & 0xF0FF)
-	{
-	case 0xF007:
-	{
-		// 0xFX07: Sets Vx to the value of the delay timer.
-		// TODO: check if correct.
-		uint8_t vx = (X86_STATE::x86_interrupt_c8_param1 & 0x0F00) >> 8;
-		timers->TIMERS_SPIN_LOCK();
-		C8_STATE::cpu.V[vx] = timers->getDelayTimer();
-		timers->TIMERS_SPIN_UNLOCK();
-		break;
-	}
-	case 0xF015:
-	{
-		// 0xFX15: Sets the delay timer to Vx.
-		// TODO: check if correct.
-		uint8_t vx = (X86_STATE::x86_interrupt_c8_param1 & 0x0F00) >> 8;
-		timers->TIMERS_SPIN_LOCK();
-		timers->setDelayTimer(C8_STATE::cpu.V[vx]);
-		timers->TIMERS_SPIN_UNLOCK();
-		break;
-	}
-	case 0xF018:
-	{
-		// 0xFX18: Sets the sound timer to Vx.
-		// TODO: check if correct.
-		uint8_t vx = (X86_STATE::x86_interrupt_c8_param1 & 0x0F00) >> 8;
-		timers->TIMERS_SPIN_LOCK();
-		timers->setSoundTimer(C8_STATE::cpu.V[vx]);
-		timers->TIMERS_SPIN_UNLOCK();
-		break;
-	}
-	default:
-	{
-		logMessage(LOGLEVEL::L_ERROR, "DEFAULT CASE REACHED IN UPDATE_TIMERS. SOMETHING IS WRONG!");
-		break;
-	}
-	}
+	// ! ! ! X86_STATE::x86_interrupt_c8_param1 contains the C8 PC that was jumped to (through the dispatch table) ! ! !
+	// Flush caches that are marked
+	cache->invalidateCacheByFlag();
+
+	// Get (or allocate) the cache, which also fills in its dispatch table entry so the next jump stays inside the cache.
+	int32_t cache_index = cache->getCacheWritableByStartC8PC(X86_STATE::x86_interrupt_c8_param1);
+
+	// The miss stub does not set a resume address, so resume at the entry point of the cache.
+	X86_STATE::x86_resume_address = cache->getEntryX86AddressByIndex(cache_index, X86_STATE::x86_interrupt_c8_param1);
 }
 
 #ifdef LIMIT_SPEED_BY_INSTRUCTIONS
@@ -525,7 +533,7 @@ void Chip8Engine::DEBUG_renderGFXText()
 	{
 		for (int x = 0; x < 64; ++x)
 		{
-			if (gfxmem[(y * 64) + x] == 0)
+			if ((gfxmem[(y * GFX_ROW_SZ) + (x / NUM_BITS_PER_BYTE)] & (0x80 >> (x % NUM_BITS_PER_BYTE))) == 0)
 				printf("O");
 			else
 				printf(" ");
@@ -1,9 +1,6 @@
 #include "stdafx.h"
 
 #include <cstdint>
-#ifdef _WIN32
-#include <Windows.h>
-#endif
 
 #include "Headers\Globals.h"
 #include "Headers\FastArrayList\FastArrayList.h"
@@ -16,9 +13,21 @@ using namespace Chip8Globals;
 
 Chip8Engine_CacheHandler::Chip8Engine_CacheHandler()
 {
-	cache_list = new FastArrayList<CACHE_REGION>(1024);
-	cache_invalidate_list = new FastArrayList<int32_t>(1024);
+	cache_list = new FastArrayList<CACHE_REGION>(MAX_NUM_CACHES);
+	cache_invalidate_list = new FastArrayList<int32_t>(MAX_NUM_CACHES);
+	cache_free_slot_list = new FastArrayList<int32_t>(MAX_NUM_CACHES);
+	cache_interval_list = new FastArrayList<int32_t>(MAX_NUM_CACHES);
+	cache_interval_max_span = 0;
+	cache_inline_range_list = new FastArrayList<CACHE_INLINE_RANGE>(MAX_CACHE_INLINE_RANGES);
+	cache_inline_range_max_span = 0;
+	inline_range_active = 0;
+	cold_code_active = 0;
+	arena = new Chip8Engine_CodeArena(CODE_ARENA_SZ);
 	setup_cache_cdecl = NULL;
+	setup_cache_dispatch_miss = NULL;
+	setup_cache_exit = NULL;
+	setup_cache_exit_param2 = NULL;
+	resetDirectory();
 
 	// Register this component in logger
 	logger->registerComponent(this);
@@ -30,6 +39,10 @@ Chip8Engine_CacheHandler::~Chip8Engine_CacheHandler()
 	logger->deregisterComponent(this);
 
 	deallocAllCacheExit();
+	delete arena;
+	delete cache_inline_range_list;
+	delete cache_interval_list;
+	delete cache_free_slot_list;
 	delete cache_list;
 }
 
@@ -41,57 +54,113 @@ std::string Chip8Engine_CacheHandler::getComponentName()
 void Chip8Engine_CacheHandler::setupCache_CDECL()
 {
 	// A small cache which is used to handle the CDECL call convention before passing off to the main cache execution point.
-	// Also contains the x86 EIP hack used to get the current EIP address and store it in the eax register.
+	// Also contains the shared exit stubs which all interrupts jump to (see CodeEmitter_x86->DYNAREC_EMIT_INTERRUPT).
 	if (setup_cache_cdecl == NULL) {
 		// Alloc cdecl setup cache for first time. Will not change after this.
 		uint8_t	bytes[] = {
 			// Below code is used to 1. start CDECL calling convention, 2. goto emulation resume point, then 3. cleanup (return point).
+			// ebx is saved as well, as the emitted code keeps V registers in bl/bh (see Dynarec->beginRegAllocBlock).
 			// 1.
 			0x55,					//0x0 PUSH ebp
 			0x89,					//0x1 (1) MOV ebp, esp
 			0b11100101,				//0x2 (2, MODRM) MOV ebp, esp
+			0x53,					//0x3 PUSH ebx
 
 			// 2.
-			0xFF,					//0x3 (1) JMP r/m32
-			0b00100101,				//0x4 (2, MODRM) JMP r/m32
-			0x00,					//0x5 (3, DISP32)
-			0x00,					//0x6 (4, DISP32)
-			0x00,					//0x7 (5, DISP32)
-			0x00,					//0x8 (6, DISP32)
+			0xFF,					//0x4 (1) JMP r/m32
+			0b00100101,				//0x5 (2, MODRM) JMP r/m32
+			0x00,					//0x6 (3, DISP32)
+			0x00,					//0x7 (4, DISP32)
+			0x00,					//0x8 (5, DISP32)
+			0x00,					//0x9 (6, DISP32)
 
 			// 3.
-			0x5D,					//0x9 POP ebp
-			0xC3,					//0xA RET
-
-			// HACK: ASM BELOW USED TO GET EIP ADDRESS AND RETURN IN EAX. SEE CodeEmitter_x86->DYNAREC_MOV_EAX_EIP.
-			0x58,					//0xB POP eax
-			0x50,					//0xC PUSH eax
-			0xC3					//0xD RET
+			0x5B,					//0xA POP ebx
+			0x5D,					//0xB POP ebp
+			0xC3,					//0xC RET
+
+			// Dispatch table miss: set the DISPATCH_MISS status and return. The C8 PC has already been stored in x86_interrupt_c8_param1 by the emitted code.
+			0xC6,					//0xD (1) MOV m, Imm8
+			0b00000101,				//0xE (2, MODRM) MOV m, Imm8
+			0x00,					//0xF (3, DISP32)
+			0x00,					//0x10 (4, DISP32)
+			0x00,					//0x11 (5, DISP32)
+			0x00,					//0x12 (6, DISP32)
+			X86_STATE::DISPATCH_MISS, //0x13 (7, IMM8)
+			0xFF,					//0x14 (1) JMP r/m32
+			0b00100101,				//0x15 (2, MODRM) JMP r/m32
+			0x00,					//0x16 (3, DISP32)
+			0x00,					//0x17 (4, DISP32)
+			0x00,					//0x18 (5, DISP32)
+			0x00,					//0x19 (6, DISP32)
+
+			// Interrupt exit with 2 params: store dx into x86_interrupt_c8_param2, then carry on into the 1 param exit below.
+			0x66,					//0x1A (1, OPERAND SIZE) MOV m16, r16
+			0x89,					//0x1B (2) MOV m16, r16
+			0b00010101,				//0x1C (3, MODRM) MOV m16, dx
+			0x00,					//0x1D (4, DISP32)
+			0x00,					//0x1E (5, DISP32)
+			0x00,					//0x1F (6, DISP32)
+			0x00,					//0x20 (7, DISP32)
+
+			// Interrupt exit: eax = resume address, cl = status code, upper 16 bits of ecx = x86_interrupt_c8_param1. Then return (same as 3.).
+			0xA3,					//0x21 (1) MOV m32, eax
+			0x00,					//0x22 (2, DISP32)
+			0x00,					//0x23 (3, DISP32)
+			0x00,					//0x24 (4, DISP32)
+			0x00,					//0x25 (5, DISP32)
+			0x88,					//0x26 (1) MOV m8, r8
+			0b00001101,				//0x27 (2, MODRM) MOV m8, cl
+			0x00,					//0x28 (3, DISP32)
+			0x00,					//0x29 (4, DISP32)
+			0x00,					//0x2A (5, DISP32)
+			0x00,					//0x2B (6, DISP32)
+			0xC1,					//0x2C (1) SHR r32, Imm8
+			0b11101001,				//0x2D (2, MODRM) SHR ecx, Imm8
+			0x10,					//0x2E (3, IMM8)
+			0x66,					//0x2F (1, OPERAND SIZE) MOV m16, r16
+			0x89,					//0x30 (2) MOV m16, r16
+			0b00001101,				//0x31 (3, MODRM) MOV m16, cx
+			0x00,					//0x32 (4, DISP32)
+			0x00,					//0x33 (5, DISP32)
+			0x00,					//0x34 (6, DISP32)
+			0x00,					//0x35 (7, DISP32)
+			0x5B,					//0x36 POP ebx
+			0x5D,					//0x37 POP ebp
+			0xC3					//0x38 RET
 		};
 		setup_cache_cdecl_sz = sizeof(bytes) / sizeof(bytes[0]);
 
-		// WIN32 specific. Allocate cache memory with read, write and execute permissions.
-#ifdef _WIN32
-		setup_cache_cdecl = (uint8_t *)VirtualAlloc(0, setup_cache_cdecl_sz, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
-#endif
-
-		// Check if memory was actually allocated.
-		if (setup_cache_cdecl == NULL) {
-			char buffer[1000];
-			sprintf_s(buffer, 1000, "Could not allocate memory for a cache. Exiting.");
-			logMessage(LOGLEVEL::L_FATAL, buffer);
-			exit(2);
-		}
+		// Allocate from the code arena (exits if there is no memory left).
+		setup_cache_cdecl = arena->allocBlock(setup_cache_cdecl_sz);
 
 		// Copy above raw x86 code into executable memory page.
+		arena->beginWrite();
 		memcpy(setup_cache_cdecl, bytes, setup_cache_cdecl_sz);
 
 		// Update variables needed throughout program.
-		setup_cache_return_jmp_address = (setup_cache_cdecl + 0x9);
-		setup_cache_eip_hack = (setup_cache_cdecl + 0xB);
+		setup_cache_return_jmp_address = (setup_cache_cdecl + 0xA);
+		setup_cache_dispatch_miss = (setup_cache_cdecl + 0xD);
+		setup_cache_exit_param2 = (setup_cache_cdecl + 0x1A);
+		setup_cache_exit = (setup_cache_cdecl + 0x21);
 
 		// Update cdecl cache with location of x86_resume_address variable (will jump to address contained in x86_resume_address).
-		*(uint32_t *)(setup_cache_cdecl + 0x5) = (uint32_t)&X86_STATE::x86_resume_address;
+		*(uint32_t *)(setup_cache_cdecl + 0x6) = (uint32_t)&X86_STATE::x86_resume_address;
+
+		// Update dispatch miss stub with the status code and cdecl return variables.
+		*(uint32_t *)(setup_cache_cdecl + 0xF) = (uint32_t)&X86_STATE::x86_interrupt_status_code;
+		*(uint32_t *)(setup_cache_cdecl + 0x16) = (uint32_t)&setup_cache_return_jmp_address;
+
+		// Update exit stubs with the interrupt variables.
+		*(uint32_t *)(setup_cache_cdecl + 0x1D) = (uint32_t)&X86_STATE::x86_interrupt_c8_param2;
+		*(uint32_t *)(setup_cache_cdecl + 0x22) = (uint32_t)&X86_STATE::x86_resume_address;
+		*(uint32_t *)(setup_cache_cdecl + 0x28) = (uint32_t)&X86_STATE::x86_interrupt_status_code;
+		*(uint32_t *)(setup_cache_cdecl + 0x32) = (uint32_t)&X86_STATE::x86_interrupt_c8_param1;
+
+		// Empty dispatch table entries can now point to the miss stub.
+		for (int32_t i = 0; i < MEMORY_SZ; i++) {
+			if (cache_directory[i].start_cache_index == -1) cache_dispatch_table[i] = setup_cache_dispatch_miss;
+		}
 
 		// DEBUG
 #ifdef USE_VERBOSE
@@ -100,7 +169,9 @@ void Chip8Engine_CacheHandler::setupCache_CDECL()
 		logMessage(LOGLEVEL::L_INFO, buffer);
 		sprintf_s(buffer, 1000, " setup_cache_return_jmp_address @ location 0x%.8X.", (uint32_t)&setup_cache_return_jmp_address);
 		logMessage(LOGLEVEL::L_INFO, buffer);
-		sprintf_s(buffer, 1000, " setup_cache_eip_hack @ location 0x%.8X.", (uint32_t)&setup_cache_eip_hack);
+		sprintf_s(buffer, 1000, " setup_cache_dispatch_miss @ location 0x%.8X.", (uint32_t)&setup_cache_dispatch_miss);
+		logMessage(LOGLEVEL::L_INFO, buffer);
+		sprintf_s(buffer, 1000, " setup_cache_exit @ location 0x%.8X.", (uint32_t)&setup_cache_exit);
 		logMessage(LOGLEVEL::L_INFO, buffer);
 		sprintf_s(buffer, 1000, " x86_resume_address @ location 0x%.8X.", (uint32_t)&X86_STATE::x86_resume_address);
 		logMessage(LOGLEVEL::L_INFO, buffer);
@@ -114,6 +185,9 @@ void Chip8Engine_CacheHandler::execCache_CDECL()
 	//void(__cdecl *exec)() = (void(__cdecl *)())setup_cache_cdecl;
 	//exec();
 
+	// Make sure all code written since the last run is executable (and no longer writable) before running it.
+	arena->endWrite();
+
 	// New method, works with optimisations turned on. TODO: Look at why we cant direcly place value of setup_cdecl_cache into eax and call.. seems to put 14h instead of address.. probably something to do with stack.
 	// CDECL calling convention, but there are no variables to push onto stack/remove from stack by changing esp.
 	// TODO: not sure if this works outside of the MS compiler (__asm tag)
@@ -132,36 +206,23 @@ void Chip8Engine_CacheHandler::initFirstCache()
 
 int32_t Chip8Engine_CacheHandler::findCacheIndexByC8PC(uint16_t c8_pc_)
 {
-	int32_t index = -1;
-	for (int32_t i = 0; i < (int32_t)cache_list->size(); i++) {
-		if (c8_pc_ >= cache_list->get_ptr(i)->c8_start_recompile_pc
-			&& c8_pc_ <= cache_list->get_ptr(i)->c8_end_recompile_pc
-			&& cache_invalidate_list->find(i) == -1
-			&& cache_list->get_ptr(i)->c8_pc_alignement == C8_STATE::C8_getPCByteAlignmentOffset(c8_pc_)) { // Need to also check for pc alignment 5/11/15
-			index = i;
-			break;
-		}
-	}
-	return index;
+	// Directory lookup. Only valid caches are recorded in the directory, and the entry is per C8 address so the pc alignment always matches.
+	if (c8_pc_ >= MEMORY_SZ) return -1;
+	return cache_directory[c8_pc_].cover_cache_index;
 }
 
 int32_t Chip8Engine_CacheHandler::findCacheIndexByStartC8PC(uint16_t c8_pc_)
 {
-	int32_t index = -1;
-	for (int32_t i = 0; i < (int32_t)cache_list->size(); i++) {
-		if (c8_pc_ == cache_list->get_ptr(i)->c8_start_recompile_pc
-			&& cache_invalidate_list->find(i) == -1) { // dont need to check for pc_alignement as its already defined to be aligned by checking against the starting pc
-			index = i;
-			break;
-		}
-	}
-	return index;
+	// Directory lookup. dont need to check for pc_alignement as its already defined to be aligned by checking against the starting pc
+	if (c8_pc_ >= MEMORY_SZ) return -1;
+	return cache_directory[c8_pc_].start_cache_index;
 }
 
 int32_t Chip8Engine_CacheHandler::findCacheIndexByX86Address(uint8_t * x86_address)
 {
 	uint8_t * x86_end = NULL;
 	for (int32_t i = 0; i < (int32_t)cache_list->size(); i++) {
+		if (cache_list->get_ptr(i)->x86_mem_address == NULL) continue; // Empty slot
 		x86_end = cache_list->get_ptr(i)->x86_mem_address + cache_list->get_ptr(i)->x86_pc;
 		if (x86_address >= cache_list->get_ptr(i)->x86_mem_address && x86_address <= x86_end) {
 			return i;
@@ -172,27 +233,48 @@ int32_t Chip8Engine_CacheHandler::findCacheIndexByX86Address(uint8_t * x86_addre
 
 int32_t Chip8Engine_CacheHandler::allocNewCacheByC8PC(uint16_t c8_start_pc_)
 {
-	// Attempt to allocate memory for cache first.
-	uint8_t * cache_mem = NULL;
+	// Attempt to allocate memory for cache first. Comes from the code arena, so there is no OS call unless the arena needs to grow (exits if there is no memory left).
+	uint8_t * cache_mem = arena->allocBlock(MAX_CACHE_SZ);
 
-	// WIN32 specific. Allocate cache memory with read, write and execute permissions.
-#ifdef _WIN32
-	if ((cache_mem = (uint8_t *)VirtualAlloc(0, MAX_CACHE_SZ, MEM_COMMIT, PAGE_EXECUTE_READWRITE)) == NULL) exit(2);
-#endif
+	// set last memory bytes to OUT_OF_CODE interrupt. The emitted code always ends with a jump to here (see writeExitJumpByIndex), so the memory in between is never run and doesn't need to be filled.
+	writeOutOfCodeStub(cache_mem + MAX_CACHE_SZ - OUT_OF_CODE_STUB_SZ, cache_mem);
 
-	// Check if memory was actually allocated.
-	if (setup_cache_cdecl == NULL) {
-		char buffer[1000];
-		sprintf_s(buffer, 1000, "Could not allocate memory for a cache. Exiting.");
-		logMessage(LOGLEVEL::L_FATAL, buffer);
-		exit(2);
+	// cache end pc is unknown at allocation, so set to start pc too (it is known if its a new cache by checking start==end pc)
+	CACHE_REGION memoryblock = { c8_start_pc_, c8_start_pc_, C8_STATE::C8_getPCByteAlignmentOffset(c8_start_pc_), cache_mem, 0, MAX_CACHE_SZ, 0, 0, new FastArrayList<uint16_t>(MAX_CACHE_SZ / 2), -1, MAX_CACHE_SZ - OUT_OF_CODE_STUB_SZ, 0, -1, -1, -1, 0 }; // Every opcode emits at least 2 bytes
+
+	// Reuse an empty slot if there is one, so indexes held by the directory (and elsewhere) never have to be shifted.
+	int32_t index;
+	if (cache_free_slot_list->size() > 0) {
+		index = cache_free_slot_list->pop_back();
+		*cache_list->get_ptr(index) = memoryblock;
 	}
+	else {
+		index = (int32_t)cache_list->push_back(memoryblock);
+	}
+
+	// Update directory
+	if (c8_start_pc_ < MEMORY_SZ) {
+		cache_directory[c8_start_pc_].start_cache_index = index;
+		cache_dispatch_table[c8_start_pc_] = cache_mem;
+	}
+	addDirectoryRangeByIndex(index, c8_start_pc_, c8_start_pc_);
+	addIntervalByIndex(index);
 
-	// Set cache to NOP 0x90. Allows for OUT_OF_CODE to be reached without changing anything.
-	memset(cache_mem, 0x90, MAX_CACHE_SZ);
+	// Cache is empty, so running it goes straight to OUT_OF_CODE.
+	writeExitJumpByIndex(index);
+
+	// DEBUG
+#ifdef USE_VERBOSE
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Cache[%d] allocated. Location and size: %p, %d, C8 Start PC = 0x%.4X.", index, cache_mem, MAX_CACHE_SZ, c8_start_pc_);
+	logMessage(LOGLEVEL::L_INFO, buffer);
+#endif
+	return index;
+}
 
-	// set last memory bytes to OUT_OF_CODE interrupt
-	// Emits change x86_status_code to 2 (out of code) & x86_interrupt_c8_param1 = c8_start_pc then jump back to cdecl return address
+void Chip8Engine_CacheHandler::writeOutOfCodeStub(uint8_t * x86_address, uint8_t * cache_mem)
+{
+	// Emits change x86_status_code to 2 (out of code) & x86_interrupt_x86_param1 = cache_mem then jump back to cdecl return address
 	uint8_t bytes[] = {
 		0xC6,		// (0) MOV m, Imm8
 		0b00000101, // (1) MOV m, Imm8
@@ -227,25 +309,17 @@ int32_t Chip8Engine_CacheHandler::allocNewCacheByC8PC(uint16_t c8_start_pc_)
 	*((uint32_t*)(bytes + 9)) = x86_resume_start_address_;
 	*((uint32_t*)(bytes + 13)) = (uint32_t)cache_mem;
 	*((uint32_t*)(bytes + 19)) = cdecl_return_address;
-	uint8_t sz = sizeof(bytes) / sizeof(bytes[0]);
-	memcpy(cache_mem + MAX_CACHE_SZ - sz, bytes, sz); // Write this to last bytes of cache
-
-	// cache end pc is unknown at allocation, so set to start pc too (it is known if its a new cache by checking start==end pc)
-	CACHE_REGION memoryblock = { c8_start_pc_, c8_start_pc_, C8_STATE::C8_getPCByteAlignmentOffset(c8_start_pc_), cache_mem, 0 };
-	cache_list->push_back(memoryblock);
-
-	// DEBUG
-#ifdef USE_VERBOSE
-	char buffer[1000];
-	sprintf_s(buffer, 1000, "Cache[%d] allocated. Location and size: %p, %d, C8 Start PC = 0x%.4X.", cache_list->size() - 1, cache_mem, MAX_CACHE_SZ, c8_start_pc_);
-	logMessage(LOGLEVEL::L_INFO, buffer);
-#endif
-	return (cache_list->size() - 1);
+	arena->beginWrite();
+	memcpy(x86_address, bytes, OUT_OF_CODE_STUB_SZ);
 }
 
 int32_t Chip8Engine_CacheHandler::getCacheWritableByStartC8PC(uint16_t c8_jump_pc)
 {
 	int32_t index = cache->findCacheIndexByStartC8PC(c8_jump_pc);
+	if (index == -1) {
+		// Reuse the code of a cache which has already translated this C8 PC.
+		index = addEntryByC8PC(c8_jump_pc);
+	}
 	if (index == -1) {
 		// No cache was found at all, so allocate a completely new cache
 		index = allocNewCacheByC8PC(c8_jump_pc);
@@ -266,6 +340,83 @@ int32_t Chip8Engine_CacheHandler::getCacheWritableByStartC8PC(uint16_t c8_jump_p
 	return index;
 }
 
+uint8_t * Chip8Engine_CacheHandler::getEntryX86AddressByIndex(int32_t index, uint16_t c8_pc_)
+{
+	if (c8_pc_ < MEMORY_SZ && cache_directory[c8_pc_].start_cache_index == index) return cache_dispatch_table[c8_pc_];
+	return cache_list->get_ptr(index)->x86_mem_address;
+}
+
+int32_t Chip8Engine_CacheHandler::addEntryByC8PC(uint16_t c8_pc_)
+{
+	if (c8_pc_ >= MEMORY_SZ) return -1;
+	int32_t index = cache_directory[c8_pc_].cover_cache_index;
+	if (index == -1 || !isEntryPointByIndex(index, c8_pc_)) return -1;
+
+	CACHE_REGION * region = cache_list->get_ptr(index);
+	cache_directory[c8_pc_].start_cache_index = index;
+	cache_dispatch_table[c8_pc_] = region->x86_mem_address + region->x86_opcode_offsets->get((c8_pc_ - region->c8_start_recompile_pc) / 2);
+
+#ifdef USE_VERBOSE
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Cache[%d] entry point added. C8 PC = 0x%.4X, x86 address = 0x%.8X.", index, c8_pc_, (uint32_t)cache_dispatch_table[c8_pc_]);
+	logMessage(LOGLEVEL::L_INFO, buffer);
+#endif
+	return index;
+}
+
+uint8_t Chip8Engine_CacheHandler::isEntryPointByIndex(int32_t index, uint16_t c8_pc_)
+{
+	CACHE_REGION * region = cache_list->get_ptr(index);
+	if (c8_pc_ <= region->c8_start_recompile_pc || c8_pc_ > region->c8_end_recompile_pc) return 0;
+
+	// The offset must be known and have code (opcodes jumped over by a followed jump have none).
+	uint32_t opcode_number = (c8_pc_ - region->c8_start_recompile_pc) / 2;
+	if (opcode_number >= region->x86_opcode_offsets->size() || region->x86_opcode_offsets->get(opcode_number) == OPCODE_X86_OFFSET_NONE) return 0;
+
+	// The code of an opcode after a skip can be shared with the skip (see Chip8Engine_Dynarec::lowerIRIfConversion), so it is not a safe place to start.
+	return !isSkipOpcode(C8_STATE::memory[c8_pc_ - 2] << 8 | C8_STATE::memory[c8_pc_ - 1]);
+}
+
+void Chip8Engine_CacheHandler::removeEntriesByIndex(int32_t index, uint16_t c8_from_pc_)
+{
+	CACHE_REGION * region = cache_list->get_ptr(index);
+	if (c8_from_pc_ <= region->c8_start_recompile_pc) c8_from_pc_ = region->c8_start_recompile_pc + 2;
+	for (uint32_t pc = c8_from_pc_; pc <= region->c8_end_recompile_pc && pc < MEMORY_SZ; pc += 2) {
+		if (cache_directory[pc].start_cache_index != index) continue;
+		cache_directory[pc].start_cache_index = -1;
+		cache_dispatch_table[pc] = setup_cache_dispatch_miss;
+		cache_start_generation[pc] += 1;
+
+		// Jumps to the entry point have to find a cache again.
+		jumptbl->clearFilledFlagByC8PC((uint16_t)pc);
+	}
+}
+
+void Chip8Engine_CacheHandler::setContinuationByIndex(int32_t index, int32_t continuation_index)
+{
+	// Add to the front of the list of caches continuing in continuation_index, so freeing it only visits those.
+	clearContinuationByIndex(index);
+	CACHE_REGION * region = cache_list->get_ptr(index);
+	CACHE_REGION * continuation_region = cache_list->get_ptr(continuation_index);
+	region->continuation_cache_index = continuation_index;
+	region->continuation_from_prev = -1;
+	region->continuation_from_next = continuation_region->continuation_from_head;
+	if (region->continuation_from_next != -1) cache_list->get_ptr(region->continuation_from_next)->continuation_from_prev = index;
+	continuation_region->continuation_from_head = index;
+}
+
+void Chip8Engine_CacheHandler::clearContinuationByIndex(int32_t index)
+{
+	CACHE_REGION * region = cache_list->get_ptr(index);
+	if (region->continuation_cache_index == -1) return;
+	if (region->continuation_from_prev != -1) cache_list->get_ptr(region->continuation_from_prev)->continuation_from_next = region->continuation_from_next;
+	else cache_list->get_ptr(region->continuation_cache_index)->continuation_from_head = region->continuation_from_next;
+	if (region->continuation_from_next != -1) cache_list->get_ptr(region->continuation_from_next)->continuation_from_prev = region->continuation_from_prev;
+	region->continuation_cache_index = -1;
+	region->continuation_from_next = -1;
+	region->continuation_from_prev = -1;
+}
+
 int32_t Chip8Engine_CacheHandler::allocAndSwitchNewCacheByC8PC(uint16_t c8_start_pc_)
 {
 	uint32_t index = allocNewCacheByC8PC(c8_start_pc_);
@@ -276,12 +427,14 @@ int32_t Chip8Engine_CacheHandler::allocAndSwitchNewCacheByC8PC(uint16_t c8_start
 void Chip8Engine_CacheHandler::deallocAllCacheExit()
 {
 	for (int32_t i = 0; i < (int32_t)cache_list->size(); i++) {
+		if (cache_list->get_ptr(i)->x86_mem_address == NULL) continue; // Empty slot
 #ifdef USE_VERBOSE
 		char buffer[1000];
 		sprintf_s(buffer, 1000, "Cache[%d] invalidated. C8 Start PC = 0x%.4X, C8 End PC = 0x%.4X.", i, cache_list->get_ptr(i)->c8_start_recompile_pc, cache_list->get_ptr(i)->c8_end_recompile_pc);
 		logMessage(LOGLEVEL::L_INFO, buffer);
 #endif
-		VirtualFree(cache_list->get_ptr(i)->x86_mem_address, 0, MEM_RELEASE);
+		arena->freeBlock(cache_list->get_ptr(i)->x86_mem_address, cache_list->get_ptr(i)->x86_mem_sz);
+		delete cache_list->get_ptr(i)->x86_opcode_offsets;
 	}
 }
 
@@ -293,9 +446,11 @@ void Chip8Engine_CacheHandler::invalidateCacheByFlag()
 		int32_t cache_index;
 		for (int32_t i = 0; i < list_sz; i++) {
 			cache_index = cache_invalidate_list->get(i);
-			if (!(X86_STATE::x86_resume_address >= cache_list->get_ptr(cache_index)->x86_mem_address && X86_STATE::x86_resume_address <= (cache_list->get_ptr(cache_index)->x86_mem_address + cache_list->get_ptr(cache_index)->x86_pc))) { // check to make sure the resume address is not currently inside this cache
+			if (!(X86_STATE::x86_resume_address >= cache_list->get_ptr(cache_index)->x86_mem_address && X86_STATE::x86_resume_address < (cache_list->get_ptr(cache_index)->x86_mem_address + cache_list->get_ptr(cache_index)->x86_mem_sz))) { // check to make sure the resume address is not currently inside this cache (including its cold code)
 																																												   // First remove any jump references to this cache
 				jumptbl->clearFilledFlagByC8PC(cache_list->get_ptr(cache_index)->c8_start_recompile_pc);
+				jumptbl->removeJumpLinksByCacheIndex(cache_index, cache_list->get_ptr(cache_index)->x86_mem_address);
+				removeInlineRangesByIndex(cache_index, 0);
 
 				// Delete cache here
 #ifdef USE_VERBOSE
@@ -303,18 +458,23 @@ void Chip8Engine_CacheHandler::invalidateCacheByFlag()
 				sprintf_s(buffer, 1000, "Cache[%d] invalidated. C8 Start PC = 0x%.4X, C8 End PC = 0x%.4X.", cache_index, cache_list->get_ptr(cache_index)->c8_start_recompile_pc, cache_list->get_ptr(cache_index)->c8_end_recompile_pc);
 				logMessage(LOGLEVEL::L_INFO, buffer);
 #endif
-				VirtualFree(cache_list->get_ptr(cache_index)->x86_mem_address, 0, MEM_RELEASE);
-				cache_list->remove(cache_index);
+				arena->freeBlock(cache_list->get_ptr(cache_index)->x86_mem_address, cache_list->get_ptr(cache_index)->x86_mem_sz); // Returned to the arena free list, no OS call
+
+				// Leave the slot empty for reuse, so the other cache indexes stay the same (directory was already updated when the flag was set).
+				delete cache_list->get_ptr(cache_index)->x86_opcode_offsets;
+				cache_list->get_ptr(cache_index)->x86_opcode_offsets = NULL;
+				cache_list->get_ptr(cache_index)->x86_mem_address = NULL;
+				cache_list->get_ptr(cache_index)->x86_pc = 0;
+				cache_list->get_ptr(cache_index)->invalid_flag = 0;
+				cache_list->get_ptr(cache_index)->truncated_flag = 0;
+				clearContinuationByIndex(cache_index);
+				cache_free_slot_list->push_back(cache_index);
+
+				// Caches that continued in this one now go through the jump table (the link jump was unlinked by clearFilledFlagByC8PC).
+				while (cache_list->get_ptr(cache_index)->continuation_from_head != -1) clearContinuationByIndex(cache_list->get_ptr(cache_index)->continuation_from_head);
 
 				// Handle selected_cache_index changes
-				if (selected_cache_index > cache_index) {
-					// Need to decrease selected_cache by 1
-					selected_cache_index -= 1;
-				}
-				//else if (selected_cache_index < i) {
-				// Do nothing, we are ok
-				//}
-				else if (selected_cache_index == cache_index) {
+				if (selected_cache_index == cache_index) {
 					// Set to -1 (need to reselect later)
 					selected_cache_index = -1;
 				}
@@ -334,46 +494,195 @@ void Chip8Engine_CacheHandler::invalidateCacheByFlag()
 
 void Chip8Engine_CacheHandler::setInvalidFlagByIndex(int32_t index)
 {
+	if (getInvalidFlagByIndex(index)) return; // Already marked
+
+	// Remove the cache from the directory straight away, so it can no longer be found (invalid caches are never returned by the find functions).
+	CACHE_REGION * region = cache_list->get_ptr(index);
+	if (region->c8_start_recompile_pc < MEMORY_SZ && cache_directory[region->c8_start_recompile_pc].start_cache_index == index) {
+		cache_directory[region->c8_start_recompile_pc].start_cache_index = -1;
+		cache_dispatch_table[region->c8_start_recompile_pc] = setup_cache_dispatch_miss;
+		cache_start_generation[region->c8_start_recompile_pc] += 1;
+	}
+	removeEntriesByIndex(index, region->c8_start_recompile_pc + 2);
+	removeDirectoryRangeByIndex(index, region->c8_start_recompile_pc, region->c8_end_recompile_pc);
+	removeIntervalByIndex(index);
+
+	// Linked jumps must not enter this cache anymore, even before it is freed.
+	jumptbl->unlinkJumpsByC8PC(region->c8_start_recompile_pc);
+
+	region->invalid_flag = 1;
 	cache_invalidate_list->push_back(index);
 }
 
 void Chip8Engine_CacheHandler::setInvalidFlagByC8PC(uint16_t c8_pc_)
+{
+	invalidateRange(c8_pc_, 1);
+}
+
+void Chip8Engine_CacheHandler::invalidateRange(uint16_t c8_start_pc_, uint16_t c8_length_)
 {
 	// Function designed to be fast, as it will be called many times
-	for (int32_t i = 0; i < (int32_t)cache_list->size(); i++) {
-		CACHE_REGION * cache = cache_list->get_ptr(i);
-		if (c8_pc_ >= cache->c8_start_recompile_pc
-			&& c8_pc_ <= cache->c8_end_recompile_pc
-			&& cache_invalidate_list->find(i) == -1
-			&& cache->c8_pc_alignement == C8_STATE::C8_getPCByteAlignmentOffset(c8_pc_)) {
-			setInvalidFlagByIndex(i);
+	if (c8_length_ == 0) return;
+	uint32_t c8_last_pc = (uint32_t)c8_start_pc_ + c8_length_ - 1;
+	if (c8_last_pc >= MEMORY_SZ) c8_last_pc = MEMORY_SZ - 1;
+
+	// Most writes are to data, which no cache covers.
+	if (c8_start_pc_ >= MEMORY_SZ || memchr(code_map + c8_start_pc_, 1, c8_last_pc - c8_start_pc_ + 1) == NULL) return;
+
+	// A cache covers the bytes [start pc, end pc + 1] (the last opcode is 2 bytes). Only caches starting at or before c8_last_pc can overlap, and as no cache is longer
+	// than cache_interval_max_span, the search can stop once the start pc is too far before c8_start_pc_.
+	// Go backwards, so removing the flagged cache from the interval list does not move the ones still to be checked.
+	for (int32_t i = findIntervalUpperBound((uint16_t)c8_last_pc) - 1; i >= 0; i--) {
+		int32_t index = cache_interval_list->get(i);
+		CACHE_REGION * region = cache_list->get_ptr(index);
+		if ((uint32_t)region->c8_start_recompile_pc + cache_interval_max_span + 1 < c8_start_pc_) break;
+		if ((uint32_t)region->c8_end_recompile_pc + 1 >= c8_start_pc_) {
+			// Keep the code before the write if possible, otherwise the whole cache goes.
+			if (!truncateCacheByIndex(index, c8_start_pc_)) setInvalidFlagByIndex(index);
 		}
 	}
+
+	// Inlined subroutines are not in the interval list, their own list is searched the same way. Flagging a cache does not remove its ranges (that is done when it is freed).
+	for (int32_t i = findInlineRangeUpperBound((uint16_t)c8_last_pc) - 1; i >= 0; i--) {
+		CACHE_INLINE_RANGE * range = cache_inline_range_list->get_ptr(i);
+		if ((uint32_t)range->c8_start_pc + cache_inline_range_max_span + 1 < c8_start_pc_) break;
+		if ((uint32_t)range->c8_end_pc + 1 >= c8_start_pc_) setInvalidFlagByIndex(range->cache_index);
+	}
 }
 
-uint8_t Chip8Engine_CacheHandler::getInvalidFlagByIndex(int32_t index)
+uint8_t Chip8Engine_CacheHandler::truncateCacheByIndex(int32_t index, uint16_t c8_pc_)
 {
-	int32_t list_index;
-	if ((list_index = cache_invalidate_list->find(index)) != -1) {
-		return 1;
+	CACHE_REGION * region = cache_list->get_ptr(index);
+
+	// Find the first opcode containing c8_pc_ (or after it, if the write starts before the cache).
+	uint16_t c8_cut_pc = region->c8_start_recompile_pc;
+	if (c8_pc_ > region->c8_start_recompile_pc) c8_cut_pc = region->c8_start_recompile_pc + ((c8_pc_ - region->c8_start_recompile_pc) / 2) * 2;
+
+	// A skip opcode jumps to the code 2 opcodes after it, which would be past the cut. Move the cut back before it.
+	// Opcodes jumped over by a followed jump have no code, so the cut is moved back to the jump.
+	uint32_t opcode_number = (c8_cut_pc - region->c8_start_recompile_pc) / 2;
+	while (c8_cut_pc > region->c8_start_recompile_pc && (isSkipOpcode(C8_STATE::memory[c8_cut_pc - 2] << 8 | C8_STATE::memory[c8_cut_pc - 1])
+		|| (opcode_number < region->x86_opcode_offsets->size() && region->x86_opcode_offsets->get(opcode_number) == OPCODE_X86_OFFSET_NONE))) {
+		c8_cut_pc -= 2;
+		opcode_number -= 1;
 	}
-	else {
+
+	// Nothing would be left (or the offset of the cut is unknown), so the whole cache has to be invalidated.
+	if (c8_cut_pc <= region->c8_start_recompile_pc || opcode_number >= region->x86_opcode_offsets->size()) return 0;
+
+	// The code after the cut is given back to the cache, so this cache can't still be running. This happens when an FX33/FX55 writes to an earlier
+	// opcode of its own cache, the whole cache is then invalidated once it has been left. The resume address may be in the cold code (an SMC check
+	// with V registers still allocated resumes there and jumps back to the normal code after it), so the whole region counts.
+	uint8_t * x86_cut_address = region->x86_mem_address + region->x86_opcode_offsets->get(opcode_number);
+	if (X86_STATE::x86_resume_address >= region->x86_mem_address && X86_STATE::x86_resume_address < region->x86_mem_address + region->x86_mem_sz) return 0;
+
+	// Linked jumps, entry points and inlined subroutines inside the removed code are gone.
+	jumptbl->removeJumpLinksByCacheIndex(index, x86_cut_address);
+	removeEntriesByIndex(index, c8_cut_pc);
+	removeInlineRangesByIndex(index, c8_cut_pc);
+
+	// Exit to the dynarec where the cut was made, the rest gets translated again by the next OUT_OF_CODE.
+	region->x86_pc = region->x86_opcode_offsets->get(opcode_number);
+	clearContinuationByIndex(index); // The jump to the continuation cache (if any) was at the end.
+	writeExitJumpByIndex(index);
+	while (region->x86_opcode_offsets->size() > opcode_number) region->x86_opcode_offsets->pop_back();
+	setCacheEndC8PCByIndex(index, c8_cut_pc - 2);
+	region->truncated_flag = 1;
+
+#ifdef USE_VERBOSE
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Cache[%d] truncated. C8 Start PC = 0x%.4X, C8 End PC = 0x%.4X.", index, region->c8_start_recompile_pc, region->c8_end_recompile_pc);
+	logMessage(LOGLEVEL::L_INFO, buffer);
+#endif
+	return 1;
+}
+
+uint8_t Chip8Engine_CacheHandler::isSkipOpcode(uint16_t opcode)
+{
+	switch (opcode & 0xF000) {
+	case 0x3000:
+	case 0x4000:
+	case 0x5000:
+	case 0x9000:
+		return 1;
+	case 0xE000:
+		return ((opcode & 0x00FF) == 0x009E || (opcode & 0x00FF) == 0x00A1);
+	default:
 		return 0;
 	}
 }
 
+void Chip8Engine_CacheHandler::writeExitJumpCurrent()
+{
+	writeExitJumpByIndex(selected_cache_index);
+}
+
+void Chip8Engine_CacheHandler::writeExitJumpByIndex(int32_t index)
+{
+	CACHE_REGION * region = cache_list->get_ptr(index);
+	uint8_t * x86_exit_address = region->x86_mem_address + region->x86_pc;
+	uint8_t * x86_stub_address = region->x86_mem_address + region->x86_mem_sz - OUT_OF_CODE_STUB_SZ;
+	uint8_t * x86_cold_address = region->x86_mem_address + region->x86_cold_pc;
+	if (x86_exit_address >= x86_stub_address) return; // Code already runs into the stub.
+
+	// Cold code sits between the normal code and the stub, so the jump must fit before it (getFreeX86SpaceCurrent keeps the room for it).
+	if (x86_cold_address < x86_stub_address && x86_exit_address + EXIT_JUMP_SZ > x86_cold_address) {
+		char buffer[1000];
+		sprintf_s(buffer, 1000, "Cache[%d] exit jump would overwrite cold code (x86_pc = %d, x86_cold_pc = %d)! Exiting.", index, region->x86_pc, region->x86_cold_pc);
+		logMessage(LOGLEVEL::L_FATAL, buffer);
+		exit(2);
+	}
+
+	arena->beginWrite();
+	if (x86_exit_address + EXIT_JUMP_SZ > x86_stub_address) {
+		// No room for the jump, use NOPs to get to the stub instead.
+		memset(x86_exit_address, 0x90, x86_stub_address - x86_exit_address);
+		return;
+	}
+	*x86_exit_address = 0xE9; // JMP rel32
+	*(int32_t *)(x86_exit_address + 1) = (int32_t)(x86_stub_address - (x86_exit_address + EXIT_JUMP_SZ));
+}
+
+void Chip8Engine_CacheHandler::recordOpcodeX86OffsetCurrent(uint16_t c8_pc_)
+{
+	// Opcodes are translated in order, so only the next one is recorded (also stops recording if the list is full).
+	// Opcodes of an inlined subroutine are not part of the cache range.
+	if (inline_range_active) return;
+	CACHE_REGION * region = cache_list->get_ptr(selected_cache_index);
+	uint32_t opcode_number = region->x86_opcode_offsets->size();
+	if (c8_pc_ == region->c8_start_recompile_pc + opcode_number * 2 && opcode_number < MAX_CACHE_SZ / 2) region->x86_opcode_offsets->push_back((uint16_t)region->x86_pc);
+}
+
+void Chip8Engine_CacheHandler::recordOpcodeX86OffsetNoneCurrent(uint16_t c8_pc_)
+{
+	if (inline_range_active) return;
+	CACHE_REGION * region = cache_list->get_ptr(selected_cache_index);
+	uint32_t opcode_number = region->x86_opcode_offsets->size();
+	if (c8_pc_ == region->c8_start_recompile_pc + opcode_number * 2 && opcode_number < MAX_CACHE_SZ / 2) region->x86_opcode_offsets->push_back(OPCODE_X86_OFFSET_NONE);
+}
+
+void Chip8Engine_CacheHandler::recordOpcodeX86OffsetGapCurrent(uint16_t c8_to_pc_)
+{
+	CACHE_REGION * region = cache_list->get_ptr(selected_cache_index);
+	uint32_t opcode_number = region->x86_opcode_offsets->size();
+	while (region->c8_start_recompile_pc + opcode_number * 2 < c8_to_pc_ && opcode_number < MAX_CACHE_SZ / 2) {
+		region->x86_opcode_offsets->push_back(OPCODE_X86_OFFSET_NONE);
+		opcode_number++;
+	}
+}
+
+uint8_t Chip8Engine_CacheHandler::getInvalidFlagByIndex(int32_t index)
+{
+	return cache_list->get_ptr(index)->invalid_flag;
+}
+
 void Chip8Engine_CacheHandler::switchCacheByC8PC(uint16_t c8_pc_)
 {
-	for (int32_t i = 0; i < (int32_t)cache_list->size(); i++) {
-		if (c8_pc_ >= cache_list->get_ptr(i)->c8_start_recompile_pc
-			&& c8_pc_ <= cache_list->get_ptr(i)->c8_end_recompile_pc
-			&& cache_invalidate_list->find(i) == -1
-			&& cache_list->get_ptr(i)->c8_pc_alignement == C8_STATE::C8_getPCByteAlignmentOffset(c8_pc_)) {
-			selected_cache_index = i;
-			// set C8 pc to end of memory region
-			C8_STATE::cpu.pc = cache_list->get_ptr(selected_cache_index)->c8_end_recompile_pc;
-			break;
-		}
+	int32_t index = findCacheIndexByC8PC(c8_pc_);
+	if (index != -1) {
+		selected_cache_index = index;
+		// set C8 pc to end of memory region
+		C8_STATE::cpu.pc = cache_list->get_ptr(selected_cache_index)->c8_end_recompile_pc;
 	}
 }
 
@@ -394,14 +703,92 @@ void Chip8Engine_CacheHandler::switchCacheByIndex(int32_t index)
 
 void Chip8Engine_CacheHandler::setCacheEndC8PCCurrent(uint16_t c8_end_pc_)
 {
-	if (cache_list->get_ptr(selected_cache_index)->c8_start_recompile_pc == 0xFFFF) cache_list->get_ptr(selected_cache_index)->c8_start_recompile_pc = c8_end_pc_;
-	cache_list->get_ptr(selected_cache_index)->c8_end_recompile_pc = c8_end_pc_;
+	if (inline_range_active) {
+		inline_range_current.c8_end_pc = c8_end_pc_;
+		return;
+	}
+	setCacheEndC8PCByIndex(selected_cache_index, c8_end_pc_);
+}
+
+void Chip8Engine_CacheHandler::beginInlineRangeCurrent(uint16_t c8_call_pc_, uint16_t c8_start_pc_)
+{
+	CACHE_INLINE_RANGE range = { selected_cache_index, c8_call_pc_, c8_start_pc_, c8_start_pc_ };
+	inline_range_current = range;
+	inline_range_active = 1;
+}
+
+void Chip8Engine_CacheHandler::endInlineRangeCurrent()
+{
+	inline_range_active = 0;
+
+	// Keep the list sorted by start pc (see invalidateRange).
+	CACHE_INLINE_RANGE * range = &inline_range_current;
+	cache_inline_range_list->insert(findInlineRangeUpperBound(range->c8_start_pc), *range);
+	if (range->c8_end_pc - range->c8_start_pc > cache_inline_range_max_span) cache_inline_range_max_span = range->c8_end_pc - range->c8_start_pc;
+	cache_list->get_ptr(range->cache_index)->inline_range_count += 1;
+
+	// The subroutine is code now, writes to it have to be checked for.
+	for (uint32_t address = range->c8_start_pc; address <= (uint32_t)range->c8_end_pc + 1 && address < MEMORY_SZ; address++) {
+		code_map_count[address] += 1;
+		code_map[address] = 1;
+	}
+
+#ifdef USE_VERBOSE
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Subroutine inlined into cache[%d]. C8 Call PC = 0x%.4X, C8 Start PC = 0x%.4X, C8 End PC = 0x%.4X.", range->cache_index, range->c8_call_pc, range->c8_start_pc, range->c8_end_pc);
+	logMessage(LOGLEVEL::L_INFO, buffer);
+#endif
+}
+
+void Chip8Engine_CacheHandler::removeInlineRangesByIndex(int32_t index, uint16_t c8_from_call_pc_)
+{
+	// Most caches have no inlined subroutines, so the list is only searched when this one does.
+	if (cache_list->get_ptr(index)->inline_range_count == 0) return;
+	for (int32_t i = (int32_t)cache_inline_range_list->size() - 1; i >= 0; i--) {
+		CACHE_INLINE_RANGE * range = cache_inline_range_list->get_ptr(i);
+		if (range->cache_index != index || range->c8_call_pc < c8_from_call_pc_) continue;
+		for (uint32_t address = range->c8_start_pc; address <= (uint32_t)range->c8_end_pc + 1 && address < MEMORY_SZ; address++) {
+			code_map_count[address] -= 1;
+			if (code_map_count[address] == 0) code_map[address] = 0;
+		}
+		cache_inline_range_list->remove(i);
+		cache_list->get_ptr(index)->inline_range_count -= 1;
+	}
+	if (cache_inline_range_list->size() == 0) cache_inline_range_max_span = 0;
+}
+
+int32_t Chip8Engine_CacheHandler::findInlineRangeUpperBound(uint16_t c8_pc_)
+{
+	int32_t low = 0;
+	int32_t high = (int32_t)cache_inline_range_list->size();
+	while (low < high) {
+		int32_t mid = (low + high) / 2;
+		if (cache_inline_range_list->get_ptr(mid)->c8_start_pc <= c8_pc_) low = mid + 1;
+		else high = mid;
+	}
+	return low;
 }
 
 void Chip8Engine_CacheHandler::setCacheEndC8PCByIndex(int32_t index, uint16_t c8_end_pc_)
 {
-	if (cache_list->get_ptr(index)->c8_start_recompile_pc == 0xFFFF) cache_list->get_ptr(index)->c8_start_recompile_pc = c8_end_pc_;
-	cache_list->get_ptr(index)->c8_end_recompile_pc = c8_end_pc_;
+	CACHE_REGION * region = cache_list->get_ptr(index);
+	if (region->c8_start_recompile_pc == 0xFFFF) {
+		// Start pc changes, so the cache has to move in the interval list.
+		if (!getInvalidFlagByIndex(index)) removeIntervalByIndex(index);
+		region->c8_start_recompile_pc = c8_end_pc_;
+		if (!getInvalidFlagByIndex(index)) addIntervalByIndex(index);
+	}
+
+	// Keep the directory in sync with the new end pc (invalid caches are not in the directory).
+	if (!getInvalidFlagByIndex(index)) {
+		if (c8_end_pc_ > region->c8_end_recompile_pc) addDirectoryRangeByIndex(index, region->c8_end_recompile_pc + 2, c8_end_pc_);
+		else if (c8_end_pc_ < region->c8_end_recompile_pc) removeDirectoryRangeByIndex(index, c8_end_pc_ + 2, region->c8_end_recompile_pc);
+	}
+
+	region->c8_end_recompile_pc = c8_end_pc_;
+	if (!getInvalidFlagByIndex(index) && region->c8_end_recompile_pc > region->c8_start_recompile_pc && region->c8_end_recompile_pc - region->c8_start_recompile_pc > cache_interval_max_span) {
+		cache_interval_max_span = region->c8_end_recompile_pc - region->c8_start_recompile_pc;
+	}
 }
 
 uint16_t Chip8Engine_CacheHandler::getEndC8PCCurrent()
@@ -415,6 +802,44 @@ uint8_t * Chip8Engine_CacheHandler::getEndX86AddressCurrent()
 	return cache_mem_current;
 }
 
+uint32_t Chip8Engine_CacheHandler::getFreeX86SpaceCurrent()
+{
+	// Normal code always leaves room for the exit jump before the cold code (see writeExitJumpByIndex). Cold code is written right up to the old x86_cold_pc.
+	CACHE_REGION * region = cache_list->get_ptr(selected_cache_index);
+	uint32_t x86_limit = region->x86_cold_pc;
+	if (!cold_code_active) x86_limit -= EXIT_JUMP_SZ;
+	if (region->x86_pc >= x86_limit) return 0;
+	return x86_limit - region->x86_pc;
+}
+
+uint8_t * Chip8Engine_CacheHandler::beginColdCodeCurrent(uint32_t sz)
+{
+	// The free space already keeps room for the exit jump after the normal code, so writeExitJumpByIndex never has to pad into the cold code.
+	CACHE_REGION * region = cache_list->get_ptr(selected_cache_index);
+	if (getFreeX86SpaceCurrent() < sz) exitCacheOverflow();
+
+	// Cold code is never cut off by truncateCacheByIndex, the space is only given back when the cache is freed.
+	cold_code_saved_x86_pc = region->x86_pc;
+	cold_code_start = region->x86_cold_pc - sz;
+	region->x86_pc = cold_code_start; // Writes are checked against the old x86_cold_pc until endColdCodeCurrent.
+	cold_code_active = 1;
+	return region->x86_mem_address + cold_code_start;
+}
+
+void Chip8Engine_CacheHandler::endColdCodeCurrent()
+{
+	CACHE_REGION * region = cache_list->get_ptr(selected_cache_index);
+	if (region->x86_pc != region->x86_cold_pc) {
+		char buffer[1000];
+		sprintf_s(buffer, 1000, "Cache[%d] cold code size mismatch (%d bytes written, %d reserved)! Exiting.", selected_cache_index, region->x86_pc - cold_code_start, region->x86_cold_pc - cold_code_start);
+		logMessage(LOGLEVEL::L_FATAL, buffer);
+		exit(2);
+	}
+	region->x86_cold_pc = cold_code_start;
+	region->x86_pc = cold_code_saved_x86_pc;
+	cold_code_active = 0;
+}
+
 CACHE_REGION * Chip8Engine_CacheHandler::getCacheInfoCurrent()
 {
 	return cache_list->get_ptr(selected_cache_index);
@@ -425,23 +850,112 @@ CACHE_REGION * Chip8Engine_CacheHandler::getCacheInfoByIndex(int32_t index)
 	return cache_list->get_ptr(index);
 }
 
+void Chip8Engine_CacheHandler::resetDirectory()
+{
+	for (int32_t i = 0; i < MEMORY_SZ; i++) {
+		cache_directory[i].start_cache_index = -1;
+		cache_directory[i].cover_cache_index = -1;
+		cache_directory[i].cover_count = 0;
+		cache_dispatch_table[i] = setup_cache_dispatch_miss;
+		cache_start_generation[i] = 0;
+		code_map_count[i] = 0;
+	}
+	memset(code_map, 0, sizeof(code_map));
+}
+
+void Chip8Engine_CacheHandler::addDirectoryRangeByIndex(int32_t index, uint16_t c8_from_pc_, uint16_t c8_to_pc_)
+{
+	for (uint32_t pc = c8_from_pc_; pc <= c8_to_pc_ && pc < MEMORY_SZ; pc += 2) {
+		cache_directory[pc].cover_count += 1;
+		if (cache_directory[pc].cover_cache_index == -1) cache_directory[pc].cover_cache_index = index;
+
+		// Both bytes of the opcode are code.
+		for (uint32_t address = pc; address <= pc + 1 && address < MEMORY_SZ; address++) {
+			code_map_count[address] += 1;
+			code_map[address] = 1;
+		}
+	}
+}
+
+void Chip8Engine_CacheHandler::removeDirectoryRangeByIndex(int32_t index, uint16_t c8_from_pc_, uint16_t c8_to_pc_)
+{
+	for (uint32_t pc = c8_from_pc_; pc <= c8_to_pc_ && pc < MEMORY_SZ; pc += 2) {
+		for (uint32_t address = pc; address <= pc + 1 && address < MEMORY_SZ; address++) {
+			code_map_count[address] -= 1;
+			if (code_map_count[address] == 0) code_map[address] = 0;
+		}
+
+		cache_directory[pc].cover_count -= 1;
+		if (cache_directory[pc].cover_cache_index != index) continue;
+
+		// This cache was the one recorded, so find another valid cache which covers this pc (only happens with overlapping caches, which is rare).
+		cache_directory[pc].cover_cache_index = -1;
+		if (cache_directory[pc].cover_count == 0) continue;
+		for (int32_t i = findIntervalUpperBound((uint16_t)pc) - 1; i >= 0; i--) {
+			int32_t interval_index = cache_interval_list->get(i);
+			CACHE_REGION * region = cache_list->get_ptr(interval_index);
+			if ((uint32_t)region->c8_start_recompile_pc + cache_interval_max_span < pc) break;
+			if (interval_index != index
+				&& pc <= region->c8_end_recompile_pc
+				&& region->c8_pc_alignement == C8_STATE::C8_getPCByteAlignmentOffset(pc)) {
+				cache_directory[pc].cover_cache_index = interval_index;
+				break;
+			}
+		}
+	}
+}
+
+int32_t Chip8Engine_CacheHandler::findIntervalUpperBound(uint16_t c8_pc_)
+{
+	int32_t low = 0;
+	int32_t high = (int32_t)cache_interval_list->size();
+	while (low < high) {
+		int32_t mid = (low + high) / 2;
+		if (cache_list->get_ptr(cache_interval_list->get(mid))->c8_start_recompile_pc <= c8_pc_) low = mid + 1;
+		else high = mid;
+	}
+	return low;
+}
+
+void Chip8Engine_CacheHandler::addIntervalByIndex(int32_t index)
+{
+	CACHE_REGION * region = cache_list->get_ptr(index);
+	cache_interval_list->insert(findIntervalUpperBound(region->c8_start_recompile_pc), index);
+	if (region->c8_end_recompile_pc > region->c8_start_recompile_pc && region->c8_end_recompile_pc - region->c8_start_recompile_pc > cache_interval_max_span) {
+		cache_interval_max_span = region->c8_end_recompile_pc - region->c8_start_recompile_pc;
+	}
+}
+
+void Chip8Engine_CacheHandler::removeIntervalByIndex(int32_t index)
+{
+	// Caches with the same start pc are next to each other, directly before the upper bound.
+	for (int32_t i = findIntervalUpperBound(cache_list->get_ptr(index)->c8_start_recompile_pc) - 1; i >= 0; i--) {
+		if (cache_interval_list->get(i) == index) {
+			cache_interval_list->remove(i);
+			break;
+		}
+	}
+	if (cache_interval_list->size() == 0) cache_interval_max_span = 0;
+}
+
 #ifdef USE_DEBUG
 void Chip8Engine_CacheHandler::DEBUG_printCacheByIndex(int32_t index)
 {
 	char buffer[1000];
 	sprintf_s(buffer, 1000, "Cache[%d]: C8_start_pc = 0x%.4X, C8_end_pc = 0x%.4X, X86_mem_address = 0x%.8X, X86_pc = 0x%.8X, ", index, cache_list->get_ptr(index)->c8_start_recompile_pc, cache_list->get_ptr(index)->c8_end_recompile_pc, (uint32_t)cache_list->get_ptr(index)->x86_mem_address, cache_list->get_ptr(index)->x86_pc);
 	logMessage(LOGLEVEL::L_DEBUG, buffer);
-	sprintf_s(buffer, 1000, " invalid_flag = %d.", (cache_invalidate_list->find(index) != -1));
+	sprintf_s(buffer, 1000, " invalid_flag = %d, truncated_flag = %d, continuation_cache_index = %d, reg_alloc_v_mask = 0x%.4X.", cache_list->get_ptr(index)->invalid_flag, cache_list->get_ptr(index)->truncated_flag, cache_list->get_ptr(index)->continuation_cache_index, cache_list->get_ptr(index)->reg_alloc_v_mask);
 	logMessage(LOGLEVEL::L_DEBUG, buffer);
 }
 
 void Chip8Engine_CacheHandler::DEBUG_printCacheList()
 {
 	for (int32_t i = 0; i < (int32_t)cache_list->size(); i++) {
+		if (cache_list->get_ptr(i)->x86_mem_address == NULL) continue; // Empty slot
 		char buffer[1000];
 		sprintf_s(buffer, 1000, "Cache[%d]: C8_start_pc = 0x%.4X, C8_end_pc = 0x%.4X, X86_mem_address = 0x%.8X, X86_pc = 0x%.8X, ", i, cache_list->get_ptr(i)->c8_start_recompile_pc, cache_list->get_ptr(i)->c8_end_recompile_pc, (uint32_t)cache_list->get_ptr(i)->x86_mem_address, cache_list->get_ptr(i)->x86_pc);
 		logMessage(LOGLEVEL::L_DEBUG, buffer);
-		sprintf_s(buffer, 1000, " invalid_flag = %d.", (cache_invalidate_list->find(i) != -1));
+		sprintf_s(buffer, 1000, " invalid_flag = %d, truncated_flag = %d, continuation_cache_index = %d, reg_alloc_v_mask = 0x%.4X.", cache_list->get_ptr(i)->invalid_flag, cache_list->get_ptr(i)->truncated_flag, cache_list->get_ptr(i)->continuation_cache_index, cache_list->get_ptr(i)->reg_alloc_v_mask);
 		logMessage(LOGLEVEL::L_DEBUG, buffer);
 	}
 }
@@ -452,8 +966,19 @@ void Chip8Engine_CacheHandler::incrementCacheX86PC(uint8_t count)
 	cache_list->get_ptr(selected_cache_index)->x86_pc += count;
 }
 
+void Chip8Engine_CacheHandler::exitCacheOverflow()
+{
+	// Should never happen, as the translator starts a new cache before this (see MAX_OPCODE_X86_SZ). Writing any further would overwrite the OUT_OF_CODE stub.
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Cache[%d] overflowed (size %d)! Exiting.", selected_cache_index, cache_list->get_ptr(selected_cache_index)->x86_mem_sz);
+	logMessage(LOGLEVEL::L_FATAL, buffer);
+	exit(2);
+}
+
 void Chip8Engine_CacheHandler::write8(uint8_t byte_)
 {
+	if (getFreeX86SpaceCurrent() < 1) exitCacheOverflow();
+	arena->beginWrite();
 	*(cache_list->get_ptr(selected_cache_index)->x86_mem_address + cache_list->get_ptr(selected_cache_index)->x86_pc) = byte_;
 #ifdef USE_DEBUG_EXTRA
 	char buffer[1000];
@@ -465,6 +990,8 @@ void Chip8Engine_CacheHandler::write8(uint8_t byte_)
 
 void Chip8Engine_CacheHandler::write16(uint16_t word_)
 {
+	if (getFreeX86SpaceCurrent() < 2) exitCacheOverflow();
+	arena->beginWrite();
 	uint8_t* cache_mem_current = cache_list->get_ptr(selected_cache_index)->x86_mem_address + cache_list->get_ptr(selected_cache_index)->x86_pc;
 	*((uint16_t*)cache_mem_current) = word_;
 #ifdef USE_DEBUG_EXTRA
@@ -477,6 +1004,8 @@ void Chip8Engine_CacheHandler::write16(uint16_t word_)
 
 void Chip8Engine_CacheHandler::write32(uint32_t dword_)
 {
+	if (getFreeX86SpaceCurrent() < 4) exitCacheOverflow();
+	arena->beginWrite();
 	uint8_t* cache_mem_current = cache_list->get_ptr(selected_cache_index)->x86_mem_address + cache_list->get_ptr(selected_cache_index)->x86_pc;
 	*((uint32_t*)cache_mem_current) = dword_;
 #ifdef USE_DEBUG_EXTRA
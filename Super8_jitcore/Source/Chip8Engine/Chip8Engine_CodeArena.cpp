@@ -0,0 +1,147 @@
+#include "stdafx.h"
+
+#include <cstdint>
+#include <Windows.h>
+
+#include "Headers\Globals.h"
+#include "Headers\FastArrayList\FastArrayList.h"
+
+#include "Headers\Chip8Engine\Chip8Engine_CodeArena.h"
+
+Chip8Engine_CodeArena::Chip8Engine_CodeArena(uint32_t arena_sz_)
+{
+	// Register this component in logger
+	logger->registerComponent(this);
+
+	arena_mem = NULL;
+	arena_sz = arena_sz_;
+	arena_commit_sz = 0;
+	arena_bump_offset = 0;
+	arena_writable = true; // Nothing has been committed yet, so the first blocks are written to straight away.
+
+	// Setup free lists. A size class can never have more free blocks than fit into the arena.
+	for (uint8_t i = 0; i < CODE_ARENA_NUM_SIZE_CLASSES; i++) {
+		uint32_t max_blocks = arena_sz / (CODE_ARENA_MIN_BLOCK_SZ << i);
+		if (max_blocks > CODE_ARENA_MAX_FREE_BLOCKS) max_blocks = CODE_ARENA_MAX_FREE_BLOCKS;
+		free_lists[i] = new FastArrayList<uint8_t *>(max_blocks + 1);
+	}
+
+	// Reserve the whole arena now (only address space, no access), memory is committed as it gets used.
+	arena_mem = (uint8_t *)VirtualAlloc(0, arena_sz, MEM_RESERVE, PAGE_NOACCESS);
+
+	// Check if memory was actually reserved.
+	if (arena_mem == NULL) {
+		char buffer[1000];
+		sprintf_s(buffer, 1000, "Could not reserve memory for the code arena. Exiting.");
+		logMessage(LOGLEVEL::L_FATAL, buffer);
+		exit(2);
+	}
+
+#ifdef USE_VERBOSE
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Code arena reserved. Location and size: 0x%.8X, %d.", (uint32_t)arena_mem, arena_sz);
+	logMessage(LOGLEVEL::L_INFO, buffer);
+#endif
+}
+
+Chip8Engine_CodeArena::~Chip8Engine_CodeArena()
+{
+	// Deregister this component in logger
+	logger->deregisterComponent(this);
+
+	for (uint8_t i = 0; i < CODE_ARENA_NUM_SIZE_CLASSES; i++) {
+		delete free_lists[i];
+	}
+
+	VirtualFree(arena_mem, 0, MEM_RELEASE);
+}
+
+std::string Chip8Engine_CodeArena::getComponentName()
+{
+	return std::string("CodeArena");
+}
+
+uint8_t Chip8Engine_CodeArena::getSizeClass(uint32_t sz)
+{
+	uint8_t size_class = 0;
+	while ((uint32_t)(CODE_ARENA_MIN_BLOCK_SZ << size_class) < sz && size_class < CODE_ARENA_NUM_SIZE_CLASSES - 1) size_class++;
+	return size_class;
+}
+
+uint32_t Chip8Engine_CodeArena::getBlockSize(uint32_t sz)
+{
+	return (CODE_ARENA_MIN_BLOCK_SZ << getSizeClass(sz));
+}
+
+void Chip8Engine_CodeArena::commitTo(uint32_t offset)
+{
+	// Only called when the bump pointer moves past the committed memory, never when reusing blocks.
+	while (arena_commit_sz < offset) {
+		uint8_t * commit_mem = NULL;
+		// Commit next chunk with the same protection as the rest of the arena.
+		commit_mem = (uint8_t *)VirtualAlloc(arena_mem + arena_commit_sz, CODE_ARENA_COMMIT_SZ, MEM_COMMIT, arena_writable ? PAGE_READWRITE : PAGE_EXECUTE_READ);
+		if (commit_mem == NULL) {
+			char buffer[1000];
+			sprintf_s(buffer, 1000, "Could not commit memory in the code arena. Exiting.");
+			logMessage(LOGLEVEL::L_FATAL, buffer);
+			exit(2);
+		}
+		arena_commit_sz += CODE_ARENA_COMMIT_SZ;
+	}
+}
+
+void Chip8Engine_CodeArena::setProtection(bool writable)
+{
+	// Flip the protection of all committed memory in one call.
+	DWORD old_protect;
+	bool success = (VirtualProtect(arena_mem, arena_commit_sz, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &old_protect) != 0);
+	if (success && !writable) FlushInstructionCache(GetCurrentProcess(), arena_mem, arena_commit_sz);
+	if (!success) {
+		char buffer[1000];
+		sprintf_s(buffer, 1000, "Could not change the code arena protection to %s. Exiting.", writable ? "RW" : "RX");
+		logMessage(LOGLEVEL::L_FATAL, buffer);
+		exit(2);
+	}
+	arena_writable = writable;
+}
+
+uint8_t * Chip8Engine_CodeArena::allocBlock(uint32_t sz)
+{
+	uint8_t size_class = getSizeClass(sz);
+	uint32_t block_sz = (CODE_ARENA_MIN_BLOCK_SZ << size_class);
+
+	// First try to reuse a freed block of the same size class.
+	if (free_lists[size_class]->size() > 0) {
+		return free_lists[size_class]->pop_back();
+	}
+
+	// Otherwise take a new block from the end of the used arena.
+	if (arena_bump_offset + block_sz > arena_sz) {
+		char buffer[1000];
+		sprintf_s(buffer, 1000, "Code arena is full (size %d)! Could not allocate a block of size %d. Exiting.", arena_sz, block_sz);
+		logMessage(LOGLEVEL::L_FATAL, buffer);
+		exit(2);
+	}
+	uint8_t * block = arena_mem + arena_bump_offset;
+	arena_bump_offset += block_sz;
+	commitTo(arena_bump_offset);
+	return block;
+}
+
+void Chip8Engine_CodeArena::freeBlock(uint8_t * address, uint32_t sz)
+{
+	free_lists[getSizeClass(sz)]->push_back(address);
+}
+
+#ifdef USE_DEBUG
+void Chip8Engine_CodeArena::DEBUG_printArena()
+{
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Code arena: location = 0x%.8X, size = %d, used = %d, committed = %d, writable = %d.", (uint32_t)arena_mem, arena_sz, arena_bump_offset, arena_commit_sz, arena_writable);
+	logMessage(LOGLEVEL::L_DEBUG, buffer);
+	for (uint8_t i = 0; i < CODE_ARENA_NUM_SIZE_CLASSES; i++) {
+		sprintf_s(buffer, 1000, " Size class %d bytes: %d free blocks.", (CODE_ARENA_MIN_BLOCK_SZ << i), free_lists[i]->size());
+		logMessage(LOGLEVEL::L_DEBUG, buffer);
+	}
+}
+#endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <cstdint>
 
 #include "Headers\Globals.h"
+#include "Headers\FastArrayList\FastArrayList.h"
 
 #include "Headers\Chip8Globals\Chip8Globals.h"
 #include "Headers\Chip8Engine\Chip8Engine_CodeEmitter_x86.h"
@@ -13,6 +14,8 @@ using namespace Chip8Globals::X86_STATE;
 
 Chip8Engine_CodeEmitter_x86::Chip8Engine_CodeEmitter_x86()
 {
+	label_fixup_list = new FastArrayList<X86_LABEL_FIXUP>(MAX_LABEL_FIXUPS);
+
 	// Register this component in logger
 	logger->registerComponent(this);
 }
@@ -21,6 +24,8 @@ Chip8Engine_CodeEmitter_x86::~Chip8Engine_CodeEmitter_x86()
 {
 	// Deregister this component in logger
 	logger->deregisterComponent(this);
+
+	delete label_fixup_list;
 }
 
 std::string Chip8Engine_CodeEmitter_x86::getComponentName()
@@ -31,42 +36,129 @@ std::string Chip8Engine_CodeEmitter_x86::getComponentName()
 #ifdef LIMIT_SPEED_BY_INSTRUCTIONS
 void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_INTERRUPT(X86_INT_STATUS_CODE code)
 {
-	MOV_ImmtoM_8((uint8_t *)(&x86_interrupt_status_code), code); // Store status code into global variable (x86_resume_address).
-	DYNAREC_EMIT_MOV_EAX_EIP(); // move current eip into eax (uses a 32-bit hack method)
-	ADD_ImmtoR_32(eax, 18); // 18 is length of next two x86 opcodes
-	DYNAREC_EMIT_RETURN_CDECL_JUMP();
+	DYNAREC_EMIT_INTERRUPT(code, 0xFFFF);
 }
 #endif
 
 void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_INTERRUPT(X86_INT_STATUS_CODE code, uint16_t c8_opcode)
 {
-	MOV_ImmtoM_8((uint8_t *)(&x86_interrupt_status_code), code); // Store status code into global variable (x86_resume_address).
-	MOV_ImmtoM_16(&x86_interrupt_c8_param1, c8_opcode); // Store optional parameter c8_opcode into global variable. USE 0xFFFF IF NOT NEEDED.
-	DYNAREC_EMIT_MOV_EAX_EIP(); // move current eip into eax (uses a 32-bit hack method)
-	ADD_ImmtoR_32(eax, 18); // 18 is length of next two x86 opcodes
-	DYNAREC_EMIT_RETURN_CDECL_JUMP();
+	// The resume address is straight after the exit jump, which is known now, so it is filled in once the jump is emitted.
+	uint8_t * x86_resume_fixup = cache->getEndX86AddressCurrent();
+	MOV_ImmtoR_32(eax, 0);
+	MOV_ImmtoR_32(ecx, ((uint32_t)c8_opcode << 16) | (uint8_t)code); // Optional parameter c8_opcode goes into x86_interrupt_c8_param1. USE 0xFFFF IF NOT NEEDED.
+	DYNAREC_EMIT_EXIT_JUMP(cache->setup_cache_exit);
+	*(uint32_t *)(x86_resume_fixup + 1) = (uint32_t)cache->getEndX86AddressCurrent();
 }
 
 void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_INTERRUPT(X86_INT_STATUS_CODE code, uint16_t c8_opcode, uint16_t c8_return_pc)
 {
-	MOV_ImmtoM_8((uint8_t *)(&x86_interrupt_status_code), code); // Store status code into global variable (x86_resume_address).
-	MOV_ImmtoM_16(&x86_interrupt_c8_param1, c8_opcode); // Store optional parameter c8_opcode into global variable. USE 0xFFFF IF NOT NEEDED.
-	MOV_ImmtoM_16(&x86_interrupt_c8_param2, c8_return_pc); // Used with stack interrupts, contains location of return c8 pc (in 0x2NNN calls)
-	DYNAREC_EMIT_MOV_EAX_EIP(); // move current eip into eax (uses a 32-bit hack method)
-	ADD_ImmtoR_32(eax, 18); // 18 is length of next two x86 opcodes
-	DYNAREC_EMIT_RETURN_CDECL_JUMP();
+	uint8_t * x86_resume_fixup = cache->getEndX86AddressCurrent();
+	MOV_ImmtoR_32(eax, 0);
+	MOV_ImmtoR_32(ecx, ((uint32_t)c8_opcode << 16) | (uint8_t)code);
+	MOV_ImmtoR_32(edx, c8_return_pc); // Used with stack interrupts, contains location of return c8 pc (in 0x2NNN calls)
+	DYNAREC_EMIT_EXIT_JUMP(cache->setup_cache_exit_param2);
+	*(uint32_t *)(x86_resume_fixup + 1) = (uint32_t)cache->getEndX86AddressCurrent();
 }
 
-void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_MOV_EAX_EIP()
+void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_INTERRUPT_JNE_COLD(X86_INT_STATUS_CODE code, uint16_t c8_opcode)
+{
+	// Only the jump is in the normal code, so it stays dense. The interrupt resumes in the normal code, so nothing has to jump back from the cold code.
+	uint8_t * x86_jump_address = cache->getEndX86AddressCurrent();
+	JNE_32(0);
+	uint8_t * x86_hot_resume_address = cache->getEndX86AddressCurrent();
+
+	// If V registers are held in bl/bh, they are written back before the interrupt and loaded again when it resumes (bl/bh are not kept across the exit), then it jumps back.
+	uint32_t reg_alloc_sz = Dynarec::reg_alloc_count * REG_ALLOC_MOV_X86_SZ;
+	uint8_t * x86_cold_address = cache->beginColdCodeCurrent((reg_alloc_sz > 0) ? reg_alloc_sz * 2 + DYNAREC_INTERRUPT_X86_SZ + 5 : DYNAREC_INTERRUPT_X86_SZ);
+	DYNAREC_EMIT_REG_ALLOC_WRITE_BACK();
+	DYNAREC_EMIT_INTERRUPT(code, c8_opcode);
+	if (reg_alloc_sz > 0) {
+		DYNAREC_EMIT_REG_ALLOC_LOADS();
+		JMP_32((int32_t)(x86_hot_resume_address - (cache->getEndX86AddressCurrent() + 5))); // relative to the end of the JMP instruction (5 bytes)
+	}
+	else {
+		*(uint32_t *)(x86_cold_address + 1) = (uint32_t)x86_hot_resume_address; // resume address of the MOV eax
+	}
+	cache->endColdCodeCurrent();
+
+	*(int32_t *)(x86_jump_address + 2) = (int32_t)(x86_cold_address - x86_hot_resume_address); // relative to the end of the JNE instruction (6 bytes)
+}
+
+void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_ALIGN(uint8_t alignment)
 {
-	// Stores EIP into eax using a special hack in 32 bit mode.
-	emitter->CALL_M_PTR_32((uint32_t*)&cache->setup_cache_eip_hack);
+	uint8_t padding = (uint8_t)((alignment - ((uint32_t)cache->getEndX86AddressCurrent() & (alignment - 1))) & (alignment - 1));
+	if (padding > 0) NOP(padding);
 }
 
-void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_RETURN_CDECL_JUMP()
+void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_HELPER_CALL(X86_HELPERS::X86_HELPER_FUNC * helper, X86_INT_STATUS_CODE code, uint16_t c8_opcode)
 {
-	MOV_RtoM_32(((uint32_t*)&x86_resume_address), eax); // Store return address in global var
-	JMP_M_PTR_32((uint32_t*)&cache->setup_cache_return_jmp_address); // jump to return address in cdecl setup cache (for pop/push cleanup)
+	// cdecl call (see X86_HELPER_CALL), the helper has already done the work of the opcode when it returns.
+	// Helpers read and write C8_STATE::cpu.V, so any V registers held in bl/bh are written back first and loaded again after (MOV leaves eax and the flags alone).
+	DYNAREC_EMIT_REG_ALLOC_WRITE_BACK();
+	PUSH_Imm32(c8_opcode);
+	CALL_M_PTR_32((uint32_t *)helper);
+	ADD_ImmtoR_32(esp, 4); // pop argument
+	DYNAREC_EMIT_REG_ALLOC_LOADS();
+	TEST_RwithR_32(eax, eax);
+
+	// Only take the interrupt if the helper wants to return to the main loop. The interrupt handler has nothing left to do, it resumes straight after.
+	DYNAREC_EMIT_INTERRUPT_JNE_COLD(code, c8_opcode);
+}
+
+void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_SMC_CHECK(uint16_t c8_opcode, uint8_t num_bytes)
+{
+	// Test the code map bytes for [I, I + num_bytes) 4 at a time (OR'ed together in ecx). Reading a few bytes past the end is ok, it can only cause an extra interrupt.
+	XOR_RwithR_32(eax, eax); // clear eax register
+	MOV_MtoR_16(ax, &C8_STATE::cpu.I);
+	AND_RwithImm_32(eax, MEMORY_SZ - 1); // keep inside the code map
+	ADD_ImmtoR_32(eax, (uint32_t)cache->code_map);
+	MOV_PTRtoR_32(ecx, eax);
+	for (uint8_t i = 4; i < num_bytes; i += 4) {
+		OR_RwithPTR_32(ecx, eax, i);
+	}
+	TEST_RwithR_32(ecx, ecx);
+
+	// Only take the interrupt if translated code is written to.
+	DYNAREC_EMIT_INTERRUPT_JNE_COLD(X86_STATE::SELF_MODIFYING_CODE, c8_opcode);
+}
+
+void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_DISPATCH_JUMP()
+{
+	MOV_RtoM_16(&x86_interrupt_c8_param1, ax); // Needed by the miss stub, to know which cache to get.
+	JMP_IdxM_PTR_32((uint32_t *)cache->cache_dispatch_table, eax);
+}
+
+void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_EXIT_JUMP(uint8_t * x86_exit_stub)
+{
+	// Direct jump to an exit stub in the cdecl setup cache (which stores the interrupt state and does the pop/ret cleanup). The setup cache never moves.
+	JMP_32((int32_t)(x86_exit_stub - (cache->getEndX86AddressCurrent() + 5))); // relative to the end of the JMP instruction (5 bytes)
+}
+
+void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_REG_ALLOC_LOADS()
+{
+	for (uint8_t i = 0; i < Dynarec::reg_alloc_count; i++) {
+		MOV_MtoR_8(getRegAllocX86Register(Dynarec::reg_alloc_c8_reg[i]), C8_STATE::cpu.V + Dynarec::reg_alloc_c8_reg[i]);
+	}
+}
+
+void Chip8Engine_CodeEmitter_x86::DYNAREC_EMIT_REG_ALLOC_WRITE_BACK()
+{
+	for (uint8_t i = 0; i < Dynarec::reg_alloc_count; i++) {
+		MOV_RtoM_8(C8_STATE::cpu.V + Dynarec::reg_alloc_c8_reg[i], getRegAllocX86Register(Dynarec::reg_alloc_c8_reg[i]));
+	}
+}
+
+bool Chip8Engine_CodeEmitter_x86::isRegAllocated(uint8_t c8_reg)
+{
+	for (uint8_t i = 0; i < Dynarec::reg_alloc_count; i++) {
+		if (Dynarec::reg_alloc_c8_reg[i] == c8_reg) return true;
+	}
+	return false;
+}
+
+X86Register Chip8Engine_CodeEmitter_x86::getRegAllocX86Register(uint8_t c8_reg)
+{
+	return (Dynarec::reg_alloc_c8_reg[0] == c8_reg) ? bl : bh;
 }
 
 void Chip8Engine_CodeEmitter_x86::MUL_RwithR_8(X86Register source)
@@ -95,6 +187,27 @@ void Chip8Engine_CodeEmitter_x86::RET()
 	cache->write8(0xC3);
 }
 
+void Chip8Engine_CodeEmitter_x86::NOP(uint8_t count)
+{
+	// Recommended multi-byte NOP forms (1 to 9 bytes), so padding is decoded as few instructions.
+	static const uint8_t nops[9][9] = {
+		{ 0x90 },
+		{ 0x66, 0x90 },
+		{ 0x0F, 0x1F, 0x00 },
+		{ 0x0F, 0x1F, 0x40, 0x00 },
+		{ 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+		{ 0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+		{ 0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00 },
+		{ 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+		{ 0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 }
+	};
+	while (count > 0) {
+		uint8_t sz = (count > 9) ? 9 : count;
+		for (uint8_t i = 0; i < sz; i++) cache->write8(nops[sz - 1][i]);
+		count -= sz;
+	}
+}
+
 void Chip8Engine_CodeEmitter_x86::POP(X86Register reg)
 {
 	uint8_t opcode = 0x58 + (uint8_t)reg;
@@ -107,6 +220,12 @@ void Chip8Engine_CodeEmitter_x86::PUSH(X86Register reg)
 	cache->write8(opcode);
 }
 
+void Chip8Engine_CodeEmitter_x86::PUSH_Imm32(uint32_t immediate)
+{
+	cache->write8(0x68);
+	cache->write32(immediate);
+}
+
 void Chip8Engine_CodeEmitter_x86::RDTSC()
 {
 	cache->write8(0x0F);
@@ -116,4 +235,9 @@ void Chip8Engine_CodeEmitter_x86::RDTSC()
 uint8_t Chip8Engine_CodeEmitter_x86::ModRegRM(uint8_t mod, X86Register reg, X86Register rm)
 {
 	return((mod << 6) | ((uint8_t)reg << 3) | (uint8_t)rm);
+}
+
+uint8_t Chip8Engine_CodeEmitter_x86::SIB(uint8_t scale, X86Register index, X86Register base)
+{
+	return((scale << 6) | ((uint8_t)index << 3) | (uint8_t)base);
 }
\ No newline at end of file
@@ -74,5 +74,5 @@ void Chip8Engine_CodeEmitter_x86::ADD_ImmtoM_16(uint16_t * dest, uint16_t immedi
 	cache->write8(0x81);
 	cache->write8(ModRegRM(0, (X86Register)0, (X86Register)MODREGRM_RM_DISP32));
 	cache->write32((uint32_t)dest);
-	cache->write32(immediate);
+	cache->write16(immediate);
 }
\ No newline at end of file
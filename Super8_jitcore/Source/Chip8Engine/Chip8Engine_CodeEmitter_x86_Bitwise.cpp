@@ -31,6 +31,18 @@ void Chip8Engine_CodeEmitter_x86::XOR_RwithM_8(X86Register dest, uint8_t * sourc
 	cache->write32((uint32_t)source);
 }
 
+void Chip8Engine_CodeEmitter_x86::OR_RwithR_8(X86Register dest, X86Register source)
+{
+	cache->write8(0x08);
+	cache->write8(ModRegRM(3, source, dest));
+}
+
+void Chip8Engine_CodeEmitter_x86::AND_RwithR_8(X86Register dest, X86Register source)
+{
+	cache->write8(0x20);
+	cache->write8(ModRegRM(3, source, dest));
+}
+
 void Chip8Engine_CodeEmitter_x86::AND_RwithImm_8(X86Register dest, uint8_t immediate)
 {
 	cache->write8(0x80);
@@ -50,6 +62,34 @@ void Chip8Engine_CodeEmitter_x86::XOR_RwithR_8(X86Register dest, X86Register sou
 	cache->write8(ModRegRM(3, source, dest));
 }
 
+void Chip8Engine_CodeEmitter_x86::XOR_RtoIdxM_8(uint8_t * base, X86Register index, X86Register source)
+{
+	cache->write8(0x30);
+	cache->write8(ModRegRM(0, source, (X86Register)MODREGRM_RM_SIB));
+	cache->write8(SIB(0, index, (X86Register)MODREGRM_RM_DISP32));
+	cache->write32((uint32_t)base);
+}
+
+void Chip8Engine_CodeEmitter_x86::OR_RwithPTR_32(X86Register dest, X86Register PTR_source, int8_t displacement)
+{
+	cache->write8(0x0B);
+	cache->write8(ModRegRM(1, dest, PTR_source));
+	cache->write8(displacement);
+}
+
+void Chip8Engine_CodeEmitter_x86::AND_RwithImm_32(X86Register dest, uint32_t immediate)
+{
+	cache->write8(0x81);
+	cache->write8(ModRegRM(3, (X86Register)4, dest));
+	cache->write32(immediate);
+}
+
+void Chip8Engine_CodeEmitter_x86::TEST_RwithR_32(X86Register dest, X86Register source)
+{
+	cache->write8(0x85);
+	cache->write8(ModRegRM(3, source, dest));
+}
+
 void Chip8Engine_CodeEmitter_x86::SHL_R_8(X86Register reg, uint8_t count)
 {
 	cache->write8(0xC0);
@@ -71,6 +111,13 @@ void Chip8Engine_CodeEmitter_x86::SHR_R_32(X86Register reg, uint8_t count)
 	cache->write8(count);
 }
 
+void Chip8Engine_CodeEmitter_x86::SHR_R_16_CL(X86Register reg)
+{
+	cache->write8(0x66);
+	cache->write8(0xD3);
+	cache->write8(ModRegRM(3, (X86Register)5, reg));
+}
+
 void Chip8Engine_CodeEmitter_x86::CMP_RwithR_8(X86Register dest, X86Register source)
 {
 	cache->write8(0x38);
@@ -89,4 +136,12 @@ void Chip8Engine_CodeEmitter_x86::CMP_RwithImm_32(X86Register dest, uint32_t imm
 	cache->write8(0x81);
 	cache->write8(ModRegRM(3, (X86Register)7, dest));
 	cache->write32(immediate);
+}
+
+void Chip8Engine_CodeEmitter_x86::CMP_RwithIdxM_32(X86Register dest, uint32_t * base, X86Register index)
+{
+	cache->write8(0x3B);
+	cache->write8(ModRegRM(0, dest, (X86Register)MODREGRM_RM_SIB));
+	cache->write8(SIB(2, index, (X86Register)MODREGRM_RM_DISP32));
+	cache->write32((uint32_t)base);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <cstdint>
 
 #include "Headers\Globals.h"
+#include "Headers\FastArrayList\FastArrayList.h"
 
 #include "Headers\Chip8Globals\Chip8Globals.h"
 #include "Headers\Chip8Engine\Chip8Engine_CodeEmitter_x86.h"
@@ -10,6 +11,103 @@
 
 using namespace Chip8Globals;
 
+void Chip8Engine_CodeEmitter_x86::JE_Label(uint16_t c8_label, bool short_jump)
+{
+	if (short_jump) {
+		JE_8(0);
+		recordLabelFixup(c8_label, 1);
+	}
+	else {
+		JE_32(0);
+		recordLabelFixup(c8_label, 4);
+	}
+}
+
+void Chip8Engine_CodeEmitter_x86::JNE_Label(uint16_t c8_label, bool short_jump)
+{
+	if (short_jump) {
+		JNE_8(0);
+		recordLabelFixup(c8_label, 1);
+	}
+	else {
+		JNE_32(0);
+		recordLabelFixup(c8_label, 4);
+	}
+}
+
+void Chip8Engine_CodeEmitter_x86::recordLabelFixup(uint16_t c8_label, uint8_t fixup_sz)
+{
+	if (label_fixup_list->size() >= MAX_LABEL_FIXUPS) {
+		char buffer[1000];
+		sprintf_s(buffer, 1000, "Too many unbound labels (%d)! Exiting.", MAX_LABEL_FIXUPS);
+		logMessage(LOGLEVEL::L_FATAL, buffer);
+		exit(2);
+	}
+
+	X86_LABEL_FIXUP fixup;
+	fixup.c8_label = c8_label;
+	fixup.x86_address_fixup = cache->getEndX86AddressCurrent() - fixup_sz;
+	fixup.fixup_sz = fixup_sz;
+	label_fixup_list->push_back(fixup);
+#ifdef USE_VERBOSE
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Label fixup[%d] recorded. C8_label = 0x%.4X, x86_address = 0x%.8X, size = %d.", label_fixup_list->size() - 1, c8_label, (uint32_t)fixup.x86_address_fixup, fixup_sz);
+	logMessage(LOGLEVEL::L_INFO, buffer);
+#endif
+}
+
+void Chip8Engine_CodeEmitter_x86::resolveLabelFixupByIndex(int32_t index)
+{
+	X86_LABEL_FIXUP * fixup = label_fixup_list->get_ptr(index);
+	// Relative to the end of the jump instruction, which is the end of the relative value.
+	int32_t relative = (int32_t)(cache->getEndX86AddressCurrent() - (fixup->x86_address_fixup + fixup->fixup_sz));
+	if (fixup->fixup_sz == 1) {
+		// The caller promised the distance fits when it chose the short encoding, so this is a translator bug rather than something to recover from.
+		if (relative > INT8_MAX) {
+			char buffer[1000];
+			sprintf_s(buffer, 1000, "Short jump to label 0x%.4X is out of range (%d bytes)! Exiting.", fixup->c8_label, relative);
+			logMessage(LOGLEVEL::L_FATAL, buffer);
+			exit(2);
+		}
+		*(int8_t *)fixup->x86_address_fixup = (int8_t)relative;
+	}
+	else {
+		*(int32_t *)fixup->x86_address_fixup = relative;
+	}
+#ifdef USE_VERBOSE
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Label fixup[%d] resolved! Value %d written to 0x%.8X (C8_label = 0x%.4X).", index, relative, (uint32_t)fixup->x86_address_fixup, fixup->c8_label);
+	logMessage(LOGLEVEL::L_INFO, buffer);
+#endif
+	label_fixup_list->remove(index);
+}
+
+void Chip8Engine_CodeEmitter_x86::bindLabelByC8PC(uint16_t c8_pc)
+{
+	// Walk backwards so removing a resolved fixup does not skip the next one.
+	for (int32_t i = (int32_t)label_fixup_list->size() - 1; i >= 0; i--) {
+		if (label_fixup_list->get_ptr(i)->c8_label == c8_pc) resolveLabelFixupByIndex(i);
+	}
+}
+
+void Chip8Engine_CodeEmitter_x86::bindAllLabels()
+{
+	while (label_fixup_list->size() > 0) {
+		resolveLabelFixupByIndex(label_fixup_list->size() - 1);
+	}
+}
+
+uint32_t Chip8Engine_CodeEmitter_x86::getUnboundLabelCount()
+{
+	return label_fixup_list->size();
+}
+
+void Chip8Engine_CodeEmitter_x86::JMP_32(int32_t relative)
+{
+	cache->write8(0xE9);
+	cache->write32(relative);
+}
+
 void Chip8Engine_CodeEmitter_x86::JMP_M_PTR_32(uint32_t * address)
 {
 	cache->write8(0xFF);
@@ -17,6 +115,26 @@ void Chip8Engine_CodeEmitter_x86::JMP_M_PTR_32(uint32_t * address)
 	cache->write32((uint32_t)address);
 }
 
+void Chip8Engine_CodeEmitter_x86::JMP_IdxM_PTR_32(uint32_t * base, X86Register index)
+{
+	cache->write8(0xFF);
+	cache->write8(ModRegRM(0, (X86Register)4, (X86Register)MODREGRM_RM_SIB));
+	cache->write8(SIB(2, index, (X86Register)MODREGRM_RM_DISP32));
+	cache->write32((uint32_t)base);
+}
+
+void Chip8Engine_CodeEmitter_x86::JMP_R_32(X86Register reg)
+{
+	cache->write8(0xFF);
+	cache->write8(ModRegRM(3, (X86Register)4, reg));
+}
+
+void Chip8Engine_CodeEmitter_x86::JC_8(int8_t relative)
+{
+	cache->write8(0x72);
+	cache->write8(relative);
+}
+
 void Chip8Engine_CodeEmitter_x86::JNC_8(int8_t relative)
 {
 	cache->write8(0x73);
@@ -30,6 +148,12 @@ void Chip8Engine_CodeEmitter_x86::JE_32(int32_t relative)
 	cache->write32(relative);
 }
 
+void Chip8Engine_CodeEmitter_x86::JE_8(int8_t relative)
+{
+	cache->write8(0x74);
+	cache->write8(relative);
+}
+
 void Chip8Engine_CodeEmitter_x86::JNE_8(int8_t relative)
 {
 	cache->write8(0x75);
@@ -43,6 +43,69 @@ void Chip8Engine_CodeEmitter_x86::MOV_RtoM_32(uint32_t * dest, X86Register sourc
 	cache->write32((uint32_t)dest);
 }
 
+void Chip8Engine_CodeEmitter_x86::MOV_PTRtoR_32(X86Register dest, X86Register PTR_source)
+{
+	cache->write8(0x8B);
+	cache->write8(ModRegRM(0, dest, PTR_source));
+}
+
+void Chip8Engine_CodeEmitter_x86::MOV_ImmtoIdxM_16(uint16_t * base, X86Register index, uint16_t immediate)
+{
+	// No base register, so SIB base = disp32 (with mod = 0).
+	cache->write8(0x66);
+	cache->write8(0xC7);
+	cache->write8(ModRegRM(0, (X86Register)0, (X86Register)MODREGRM_RM_SIB));
+	cache->write8(SIB(1, index, (X86Register)MODREGRM_RM_DISP32));
+	cache->write32((uint32_t)base);
+	cache->write16(immediate);
+}
+
+void Chip8Engine_CodeEmitter_x86::MOV_IdxMtoR_8(X86Register dest, uint8_t * base, X86Register index)
+{
+	cache->write8(0x8A);
+	cache->write8(ModRegRM(0, dest, (X86Register)MODREGRM_RM_SIB));
+	cache->write8(SIB(0, index, (X86Register)MODREGRM_RM_DISP32));
+	cache->write32((uint32_t)base);
+}
+
+void Chip8Engine_CodeEmitter_x86::MOV_IdxMtoR_16(X86Register dest, uint16_t * base, X86Register index)
+{
+	cache->write8(0x66);
+	cache->write8(0x8B);
+	cache->write8(ModRegRM(0, dest, (X86Register)MODREGRM_RM_SIB));
+	cache->write8(SIB(1, index, (X86Register)MODREGRM_RM_DISP32));
+	cache->write32((uint32_t)base);
+}
+
+void Chip8Engine_CodeEmitter_x86::MOV_ImmtoIdxM_32(uint32_t * base, X86Register index, uint32_t immediate)
+{
+	cache->write8(0xC7);
+	cache->write8(ModRegRM(0, (X86Register)0, (X86Register)MODREGRM_RM_SIB));
+	cache->write8(SIB(2, index, (X86Register)MODREGRM_RM_DISP32));
+	cache->write32((uint32_t)base);
+	cache->write32(immediate);
+}
+
+void Chip8Engine_CodeEmitter_x86::MOV_IdxMtoR_32(X86Register dest, uint32_t * base, X86Register index)
+{
+	cache->write8(0x8B);
+	cache->write8(ModRegRM(0, dest, (X86Register)MODREGRM_RM_SIB));
+	cache->write8(SIB(2, index, (X86Register)MODREGRM_RM_DISP32));
+	cache->write32((uint32_t)base);
+}
+
+void Chip8Engine_CodeEmitter_x86::MOV_RtoR_8(X86Register dest, X86Register source)
+{
+	cache->write8(0x88);
+	cache->write8(ModRegRM(3, source, dest));
+}
+
+void Chip8Engine_CodeEmitter_x86::MOV_RtoR_32(X86Register dest, X86Register source)
+{
+	cache->write8(0x89);
+	cache->write8(ModRegRM(3, source, dest));
+}
+
 void Chip8Engine_CodeEmitter_x86::MOV_ImmtoR_8(X86Register dest, uint8_t immediate)
 {
 	cache->write8(0xB0 + (uint8_t)dest);
@@ -86,4 +149,32 @@ void Chip8Engine_CodeEmitter_x86::MOV_ImmtoM_16(uint16_t * dest, uint16_t immedi
 	cache->write8(ModRegRM(0, (X86Register)0, (X86Register)5));
 	cache->write32((uint32_t)dest);
 	cache->write16(immediate);
+}
+
+void Chip8Engine_CodeEmitter_x86::CMOVE_RwithR_32(X86Register dest, X86Register source)
+{
+	cache->write8(0x0F);
+	cache->write8(0x44);
+	cache->write8(ModRegRM(3, dest, source));
+}
+
+void Chip8Engine_CodeEmitter_x86::CMOVNE_RwithR_32(X86Register dest, X86Register source)
+{
+	cache->write8(0x0F);
+	cache->write8(0x45);
+	cache->write8(ModRegRM(3, dest, source));
+}
+
+void Chip8Engine_CodeEmitter_x86::SETC_R_8(X86Register dest)
+{
+	cache->write8(0x0F);
+	cache->write8(0x92);
+	cache->write8(ModRegRM(3, (X86Register)0, dest));
+}
+
+void Chip8Engine_CodeEmitter_x86::SETNC_R_8(X86Register dest)
+{
+	cache->write8(0x0F);
+	cache->write8(0x93);
+	cache->write8(ModRegRM(3, (X86Register)0, dest));
 }
\ No newline at end of file
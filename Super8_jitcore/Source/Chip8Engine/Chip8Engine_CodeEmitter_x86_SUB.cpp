@@ -17,6 +17,12 @@ void Chip8Engine_CodeEmitter_x86::SUB_MfromR_8(X86Register dest, uint8_t* source
 	cache->write32((uint32_t)source);
 }
 
+void Chip8Engine_CodeEmitter_x86::SUB_RfromR_8(X86Register dest, X86Register source)
+{
+	cache->write8(0x28);
+	cache->write8(ModRegRM(3, source, dest));
+}
+
 void Chip8Engine_CodeEmitter_x86::SUB_ImmfromR_8(X86Register dest, uint8_t immediate)
 {
 	cache->write8(0x80);
@@ -33,6 +33,12 @@ std::string Chip8Engine_Dynarec::getComponentName()
 }
 
 void Chip8Engine_Dynarec::emulateTranslatorCycle() {
+	// Opcodes with an IR form are translated in a block together with the ones after them.
+	if (Chip8Engine_IR::hasIRForm(C8_STATE::opcode)) {
+		translateIRBlock();
+		return;
+	}
+
 	// Decode Opcode
 	// Initially work out what type of opcode it is by AND with 0xF000 and branch from that (looks at MSB)
 	switch (C8_STATE::opcode & 0xF000) {
@@ -45,36 +51,15 @@ void Chip8Engine_Dynarec::emulateTranslatorCycle() {
 	case 0x2000:
 		handleOpcodeMSN_2();
 		break;
-	case 0x3000:
-		handleOpcodeMSN_3();
-		break;
-	case 0x4000:
-		handleOpcodeMSN_4();
-		break;
-	case 0x5000:
-		handleOpcodeMSN_5();
-		break;
-	case 0x6000:
-		handleOpcodeMSN_6();
-		break;
-	case 0x7000:
-		handleOpcodeMSN_7();
-		break;
 	case 0x8000:
 		handleOpcodeMSN_8();
 		break;
 	case 0x9000:
 		handleOpcodeMSN_9();
 		break;
-	case 0xA000:
-		handleOpcodeMSN_A();
-		break;
 	case 0xB000:
 		handleOpcodeMSN_B();
 		break;
-	case 0xC000:
-		handleOpcodeMSN_C();
-		break;
 	case 0xD000:
 		handleOpcodeMSN_D();
 		break;
@@ -93,13 +78,179 @@ void Chip8Engine_Dynarec::emulateTranslatorCycle() {
 	}
 }
 
+bool Chip8Engine_Dynarec::isLoopHead(uint16_t c8_pc)
+{
+	// Jumps which have already been translated to this pc.
+	if (c8_pc < MEMORY_SZ && jumptbl->jump_index_by_c8pc[c8_pc] != -1) return true;
+
+	// Dense loops end in a short jump back to the start.
+	for (uint16_t pc = c8_pc; pc < c8_pc + LOOP_HEAD_MAX_SCAN && pc + 1 < MEMORY_SZ; pc += 2) {
+		uint16_t opcode = C8_STATE::memory[pc] << 8 | C8_STATE::memory[pc + 1];
+		if (opcode == (0x1000 | c8_pc)) return true;
+	}
+	return false;
+}
+
+bool Chip8Engine_Dynarec::isShortSkip(uint16_t c8_skipped_pc)
+{
+#if defined(USE_DEBUG_EXTRA) || defined(LIMIT_SPEED_BY_INSTRUCTIONS)
+	// An extra interrupt is emitted around every opcode, always use rel32.
+	return false;
+#else
+	if (c8_skipped_pc + 1 >= MEMORY_SZ) return false;
+	uint16_t skipped_opcode = C8_STATE::memory[c8_skipped_pc] << 8 | C8_STATE::memory[c8_skipped_pc + 1];
+
+	// Only opcodes with a small, fixed amount of code. Ones which use the stack/dispatch table, check for self modifying code or draw sprites (0x00EE, 0x2NNN, 0xBNNN, 0xDXYN, 0xFX33, 0xFX55) can go over.
+	// 0x1NNN is an interrupt and a jump (21 bytes), and helper calls are under 75 bytes with the V register write backs/loads (see DYNAREC_EMIT_HELPER_CALL). Up to 15 bytes of loop head padding can come before any of them.
+	switch (skipped_opcode & 0xF000) {
+	case 0x0000:
+		return (skipped_opcode != 0x00EE);
+	case 0x1000: case 0x3000: case 0x4000: case 0x5000: case 0x6000: case 0x7000:
+	case 0x8000: case 0x9000: case 0xA000: case 0xC000: case 0xE000:
+		return true;
+	case 0xF000:
+		switch (skipped_opcode & 0x00FF) {
+		case 0x0007: case 0x000A: case 0x0015: case 0x0018: case 0x001E: case 0x0029: case 0x0065:
+			return true;
+		default:
+			return false;
+		}
+	default:
+		return false;
+	}
+#endif
+}
+
+void Chip8Engine_Dynarec::beginRegAllocBlock()
+{
+	Dynarec::reg_alloc_block_start = false;
+	Dynarec::reg_alloc_count = 0;
+#if !defined(USE_DEBUG_EXTRA) && !defined(LIMIT_SPEED_BY_INSTRUCTIONS)
+	// Count the uses of each V register up to the first opcode which leaves the block (or ends it). Followed jumps and inlined subroutines are not looked into.
+	uint32_t uses[NUM_V_REG] = { 0 };
+	for (uint32_t i = 0; i < SUPERBLOCK_MAX_OPCODES; i++) {
+		uint16_t c8_pc = C8_STATE::cpu.pc + i * 2;
+		if (c8_pc > C8_STATE::rom_sz || c8_pc + 1 >= MEMORY_SZ) break;
+		uint16_t opcode = C8_STATE::memory[c8_pc] << 8 | C8_STATE::memory[c8_pc + 1];
+		uint8_t vx = (opcode & 0x0F00) >> 8;
+		uint8_t vy = (opcode & 0x00F0) >> 4;
+		if (opcode == 0x00EE || (opcode & 0xF000) == 0x1000 || (opcode & 0xF000) == 0x2000 || (opcode & 0xF000) == 0xB000) break;
+		if ((opcode & 0xF0FF) == 0xF033 || (opcode & 0xF0FF) == 0xF055) break;
+		switch (opcode & 0xF000) {
+		case 0x3000: case 0x4000: case 0x6000: case 0x7000: case 0xC000: case 0xE000:
+			uses[vx]++;
+			break;
+		case 0x5000: case 0x9000:
+			uses[vx]++;
+			uses[vy]++;
+			break;
+		case 0x8000:
+			uses[vx]++;
+			uses[vy]++;
+			if ((opcode & 0x000F) >= 0x0004) uses[0xF]++;
+			break;
+		case 0xF000:
+			if ((opcode & 0x00FF) != 0x0065) uses[vx]++; // 0xFX65 reads memory into V0 -> Vx, the allocated ones are loaded again after
+			break;
+		}
+	}
+
+	// Most used first (bl, then bh).
+	for (uint8_t i = 0; i < REG_ALLOC_MAX_REGS; i++) {
+		int8_t best = -1;
+		for (uint8_t v = 0; v < NUM_V_REG; v++) {
+			if (uses[v] >= REG_ALLOC_MIN_USES && (best == -1 || uses[v] > uses[best])) best = v;
+		}
+		if (best == -1) break;
+		Dynarec::reg_alloc_c8_reg[i] = (uint8_t)best;
+		Dynarec::reg_alloc_count++;
+		uses[best] = 0;
+		cache->getCacheInfoByIndex(cache->findCacheIndexCurrent())->reg_alloc_v_mask |= (1 << best);
+	}
+	emitter->DYNAREC_EMIT_REG_ALLOC_LOADS();
+#endif
+}
+
+void Chip8Engine_Dynarec::endRegAllocBlock()
+{
+	emitter->DYNAREC_EMIT_REG_ALLOC_WRITE_BACK();
+	Dynarec::reg_alloc_count = 0;
+}
+
+void Chip8Engine_Dynarec::emitRegAllocExit()
+{
+	emitter->DYNAREC_EMIT_REG_ALLOC_WRITE_BACK();
+
+	// Nothing after the exit is run, unless a skip over it lands there (bound at the end of the translator loop), which still needs to write back.
+	if (emitter->getUnboundLabelCount() == 0) Dynarec::reg_alloc_count = 0;
+}
+
+X86Register Chip8Engine_Dynarec::emitReadV(X86Register scratch, uint8_t c8_reg)
+{
+	if (emitter->isRegAllocated(c8_reg)) return emitter->getRegAllocX86Register(c8_reg);
+	emitter->MOV_MtoR_8(scratch, C8_STATE::cpu.V + c8_reg);
+	return scratch;
+}
+
+void Chip8Engine_Dynarec::emitLoadV(X86Register dest, uint8_t c8_reg)
+{
+	if (emitter->isRegAllocated(c8_reg)) emitter->MOV_RtoR_8(dest, emitter->getRegAllocX86Register(c8_reg));
+	else emitter->MOV_MtoR_8(dest, C8_STATE::cpu.V + c8_reg);
+}
+
+void Chip8Engine_Dynarec::emitStoreV(uint8_t c8_reg, X86Register source)
+{
+	if (!emitter->isRegAllocated(c8_reg)) emitter->MOV_RtoM_8(C8_STATE::cpu.V + c8_reg, source);
+	else if (emitter->getRegAllocX86Register(c8_reg) != source) emitter->MOV_RtoR_8(emitter->getRegAllocX86Register(c8_reg), source);
+}
+
+void Chip8Engine_Dynarec::emitStoreVImm(uint8_t c8_reg, uint8_t num)
+{
+	if (emitter->isRegAllocated(c8_reg)) emitter->MOV_ImmtoR_8(emitter->getRegAllocX86Register(c8_reg), num);
+	else emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + c8_reg, num);
+}
+
+bool Chip8Engine_Dynarec::canFollowJump(uint16_t c8_jump_pc)
+{
+	uint16_t c8_pc = C8_STATE::cpu.pc;
+	if (Dynarec::block_opcode_count >= SUPERBLOCK_MAX_OPCODES) return false;
+	if (Dynarec::inline_return_pc != NO_INLINE_RETURN) return false; // The subroutine range has to stay in one piece.
+	if (emitter->getUnboundLabelCount() > 0) return false; // A skip over this jump lands on the code after it, so the jump has to be emitted.
+	if (c8_jump_pc <= c8_pc || c8_jump_pc - c8_pc > SUPERBLOCK_MAX_JUMP_GAP || (c8_jump_pc - c8_pc) % 2 != 0) return false;
+	return (c8_jump_pc <= C8_STATE::rom_sz);
+}
+
+bool Chip8Engine_Dynarec::canInlineSubroutine(uint16_t c8_sub_pc)
+{
+	if (Dynarec::block_opcode_count >= SUPERBLOCK_MAX_OPCODES) return false;
+	if (Dynarec::inline_return_pc != NO_INLINE_RETURN) return false; // Only one level
+	if (emitter->getUnboundLabelCount() > 0) return false; // The label could be bound inside the subroutine.
+	if (cache->cache_inline_range_list->size() >= MAX_CACHE_INLINE_RANGES) return false;
+
+	// Look for the 0x00EE. Every opcode before it must have a small amount of code and must not leave the subroutine (no jumps, calls or a skip over the return).
+	uint16_t previous_opcode = 0;
+	for (uint32_t i = 0; i <= SUPERBLOCK_MAX_INLINE_OPCODES; i++) {
+		uint16_t c8_pc = c8_sub_pc + i * 2;
+		if (c8_pc > C8_STATE::rom_sz || c8_pc + 1 >= MEMORY_SZ) return false;
+		uint16_t opcode = C8_STATE::memory[c8_pc] << 8 | C8_STATE::memory[c8_pc + 1];
+		if (opcode == 0x00EE) {
+			if (i > 0 && cache->isSkipOpcode(previous_opcode)) return false;
+			// Can't continue in a new cache part way through the subroutine, so all of it must fit.
+			return (cache->getFreeX86SpaceCurrent() >= i * SUPERBLOCK_INLINE_OPCODE_X86_SZ + MAX_OPCODE_X86_SZ);
+		}
+		if ((opcode & 0xF000) == 0x1000 || !isShortSkip(c8_pc)) return false;
+		previous_opcode = opcode;
+	}
+	return false;
+}
+
 void Chip8Engine_Dynarec::handleOpcodeMSN_0() {
 	switch (C8_STATE::opcode) {
 	case 0x00E0:
 	{
 		// 0x00E0: Clears the screen
 		// Uses interpreter
-		emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::USE_INTERPRETER, C8_STATE::opcode);
+		emitter->DYNAREC_EMIT_HELPER_CALL(&X86_HELPERS::x86_helper_USE_INTERPRETER, X86_STATE::USE_INTERPRETER, C8_STATE::opcode);
 
 		// Set region pc to current c8 pc
 		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
@@ -111,6 +262,35 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_0() {
 		// 0x00EE: Returns from a subroutine - direct jump (uses stack)!
 		// TODO: Check if correct.
 
+		// End of an inlined subroutine, carry on after the call.
+		if (Dynarec::inline_return_pc != NO_INLINE_RETURN) {
+			cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
+			cache->endInlineRangeCurrent();
+			C8_STATE::cpu.pc = Dynarec::inline_return_pc;
+			Dynarec::inline_return_pc = NO_INLINE_RETURN;
+			break;
+		}
+
+		// Pop the return C8 PC off the stack and jump to it without leaving the cache.
+		emitRegAllocExit();
+		emitter->XOR_RwithR_32(eax, eax); // clear eax register
+		emitter->MOV_MtoR_8(al, &stack->sp);
+		emitter->SUB_ImmfromR_8(al, 1);
+		uint8_t * x86_slow_path_jump = cache->getEndX86AddressCurrent();
+		emitter->JC_8(0); // Stack is empty, let the stack handler deal with it. Relative value is filled in below.
+		emitter->MOV_RtoM_8(&stack->sp, al);
+		emitter->MOV_IdxMtoR_32(ecx, stack->x86_return_generation, eax);
+		emitter->MOV_IdxMtoR_32(edx, (uint32_t *)stack->x86_return_address, eax);
+		emitter->MOV_IdxMtoR_16(ax, (uint16_t *)stack->stack, eax);
+		emitter->AND_RwithImm_32(eax, MEMORY_SZ - 1);
+
+		// Use the predicted return address if the cache it points to has not been invalidated since the call was translated, otherwise go through the dispatch table.
+		emitter->CMP_RwithIdxM_32(ecx, cache->cache_start_generation, eax);
+		emitter->JNE_8(2); // skip the JMP edx (2 bytes)
+		emitter->JMP_R_32(edx);
+		emitter->DYNAREC_EMIT_DISPATCH_JUMP();
+		*(int8_t *)(x86_slow_path_jump + 1) = (int8_t)(cache->getEndX86AddressCurrent() - (x86_slow_path_jump + 2));
+
 		// Emit jump
 		emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::PREPARE_FOR_STACK_JUMP, C8_STATE::opcode);
 		emitter->JMP_M_PTR_32((uint32_t*)&stack->x86_address_to);
@@ -147,13 +327,45 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_1() {
 	// Get values
 	uint16_t jump_c8_pc = C8_STATE::opcode & 0x0FFF;
 
+	// Carry on translating at the jump target if it is close enough, no code is needed for the jump.
+	if (canFollowJump(jump_c8_pc)) {
+		cache->recordOpcodeX86OffsetGapCurrent(jump_c8_pc);
+		// Set region pc to before the jump target (covers the opcodes jumped over)
+		cache->setCacheEndC8PCCurrent(jump_c8_pc - 2);
+		C8_STATE::cpu.pc = jump_c8_pc;
+		return;
+	}
+
 	// Get jump table entry
 	int32_t tblindex = jumptbl->getJumpIndexByC8PC(jump_c8_pc);
 
 	// Emit jump
+	emitRegAllocExit();
+
+	// A linked backward (or self) jump is a loop that never leaves the cache, so the main loop would never draw or poll events again. Count them down
+	// and take the interrupt every BACKWARD_JUMP_BUDGET jumps, forward jumps can't loop without one.
+	uint8_t * x86_budget_jump = NULL;
+	if (jump_c8_pc <= C8_STATE::cpu.pc) {
+		emitter->ADD_ImmtoM_16(&X86_STATE::x86_backward_jump_budget, 0xFFFF); // Sets ZF when the budget runs out
+		x86_budget_jump = cache->getEndX86AddressCurrent();
+		emitter->JE_8(0); // Relative value is filled in below.
+	}
+
+	uint8_t * x86_address_link = cache->getEndX86AddressCurrent();
 	emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::PREPARE_FOR_JUMP, jump_c8_pc);
 	emitter->JMP_M_PTR_32((uint32_t*)&jumptbl->getJumpInfoByIndex(tblindex)->x86_address_to);
 
+	// Record the interrupt location so it can be patched into a direct jump once the target cache exists (block linking).
+	jumptbl->recordJumpLinkEntry(jump_c8_pc, x86_address_link);
+
+	// The budget exit is never linked, so it always goes through the main loop.
+	if (x86_budget_jump != NULL) {
+		*(int8_t *)(x86_budget_jump + 1) = (int8_t)(cache->getEndX86AddressCurrent() - (x86_budget_jump + 2));
+		emitter->MOV_ImmtoM_16(&X86_STATE::x86_backward_jump_budget, BACKWARD_JUMP_BUDGET);
+		emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::PREPARE_FOR_JUMP, jump_c8_pc);
+		emitter->JMP_M_PTR_32((uint32_t*)&jumptbl->getJumpInfoByIndex(tblindex)->x86_address_to);
+	}
+
 	// Need to change pc to jump address as it will cause problems if its not pc-aligned to 0 throughout the whole program
 	// Set region pc to current c8 pc
 	cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
@@ -165,6 +377,41 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_1() {
 void Chip8Engine_Dynarec::handleOpcodeMSN_2() {
 	// Only one subtype of opcode in this branch
 	// 0x2NNN calls the subroutine at address 0xNNN - direct jump, however handle using stack
+	uint16_t jump_c8_pc = C8_STATE::opcode & 0x0FFF;
+
+	// Translate a small subroutine in place, the 0x00EE at its end carries on from the opcode after this one.
+	if (canInlineSubroutine(jump_c8_pc)) {
+		// Set region pc to current c8 pc
+		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
+		cache->beginInlineRangeCurrent(C8_STATE::cpu.pc, jump_c8_pc);
+		Dynarec::inline_return_pc = C8_STATE::cpu.pc + 2;
+		C8_STATE::cpu.pc = jump_c8_pc;
+		return;
+	}
+
+	// Get the cache for the return C8 PC now, so its address can be pushed along with the return C8 PC (as a prediction for 0x00EE).
+	uint16_t return_c8_pc = C8_STATE::cpu.pc + 2;
+	int32_t return_cache_index = cache->getCacheWritableByStartC8PC(return_c8_pc);
+
+	// Push the return C8 PC onto the stack, so 0x00EE can pop it without leaving the cache.
+	emitRegAllocExit();
+	emitter->XOR_RwithR_32(eax, eax); // clear eax register
+	emitter->MOV_MtoR_8(al, &stack->sp);
+	emitter->CMP_RwithImm_8(al, NUM_STACK_LVLS - 1);
+	uint8_t * x86_slow_path_jump = cache->getEndX86AddressCurrent();
+	emitter->JNC_8(0); // Stack is full, let the stack handler deal with it. Relative value is filled in below.
+	emitter->MOV_ImmtoIdxM_16((uint16_t *)stack->stack, eax, return_c8_pc);
+	emitter->MOV_ImmtoIdxM_32((uint32_t *)stack->x86_return_address, eax, (uint32_t)cache->getEntryX86AddressByIndex(return_cache_index, return_c8_pc));
+	emitter->MOV_ImmtoIdxM_32(stack->x86_return_generation, eax, (return_c8_pc < MEMORY_SZ) ? cache->cache_start_generation[return_c8_pc] : STACK_NO_GENERATION);
+	emitter->ADD_ImmtoM_8(&stack->sp, 1);
+
+	// Then the same as a 0x1NNN jump.
+	int32_t tblindex = jumptbl->getJumpIndexByC8PC(jump_c8_pc);
+	uint8_t * x86_address_link = cache->getEndX86AddressCurrent();
+	emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::PREPARE_FOR_JUMP, jump_c8_pc);
+	emitter->JMP_M_PTR_32((uint32_t*)&jumptbl->getJumpInfoByIndex(tblindex)->x86_address_to);
+	jumptbl->recordJumpLinkEntry(jump_c8_pc, x86_address_link);
+	*(int8_t *)(x86_slow_path_jump + 1) = (int8_t)(cache->getEndX86AddressCurrent() - (x86_slow_path_jump + 2));
 
 	// Emit jump
 	emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::PREPARE_FOR_STACK_JUMP, C8_STATE::opcode, C8_STATE::cpu.pc + 2);
@@ -177,324 +424,26 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_2() {
 	Dynarec::block_finished = true;
 }
 
-void Chip8Engine_Dynarec::handleOpcodeMSN_3() {
-	// Only one subtype of opcode in this branch
-	// 0x3XNN skips next instruction if VX equals NN.
-	// TODO: check if correct
-
-	// First determine values
-	uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8;
-	uint8_t num = (C8_STATE::opcode & 0x00FF);
-
-	// Emit conditional code
-	emitter->MOV_MtoR_8(al, &C8_STATE::cpu.V[vx]);
-	emitter->CMP_RwithImm_8(al, num);
-	emitter->JE_32(0x00000000); // to fill in by jump table
-
-	// Record cond jump in table (so it will get updated on every translator loop)
-	jumptbl->recordConditionalJumpEntry(C8_STATE::cpu.pc, C8_STATE::cpu.pc + 4, 2, (uint32_t *)(cache->getEndX86AddressCurrent() - 4)); // address is located at current x86 pc - 4 (relative takes up 4 bytes)
-
-	// Set region pc to current c8 pc
-	cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-	// Change C8 PC
-	C8_STATE::C8_incrementPC();
-}
-
-void Chip8Engine_Dynarec::handleOpcodeMSN_4() {
-	// Only one subtype of opcode in this branch
-	// 0x4XNN skips next instruction if VX does not equal NN
-	// TODO: check if correct
-	// First determine values
-	uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8;
-	uint8_t num = (C8_STATE::opcode & 0x00FF);
-
-	// Emit conditional code
-	emitter->MOV_MtoR_8(al, &C8_STATE::cpu.V[vx]);
-	emitter->CMP_RwithImm_8(al, num);
-	emitter->JNE_32(0x00000000); // to fill in by jump table
-
-	// Record cond jump in table (so it will get updated on every translator loop)
-	jumptbl->recordConditionalJumpEntry(C8_STATE::cpu.pc, C8_STATE::cpu.pc + 4, 2, (uint32_t *)(cache->getEndX86AddressCurrent() - 4)); // address is located at current x86 pc - 4 (relative takes up 4 bytes)
-
-	// Set region pc to current c8 pc
-	cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-	// Change C8 PC
-	C8_STATE::C8_incrementPC();
-}
-
-void Chip8Engine_Dynarec::handleOpcodeMSN_5() {
-	// Only one subtype of opcode in this branch
-	// 0x5XY0 skips next instruction if VX equals XY
-	// TODO: check if correct
-	// First determine values
-	uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8;
-	uint8_t vy = (C8_STATE::opcode & 0x00F0) >> 4;
-
-	// Emit conditional code
-	emitter->MOV_MtoR_8(al, &C8_STATE::cpu.V[vx]);
-	emitter->MOV_MtoR_8(cl, &C8_STATE::cpu.V[vy]);
-	emitter->CMP_RwithR_8(al, cl);
-	emitter->JE_32(0x00000000); // to fill in by jump table
-
-	// Record cond jump in table (so it will get updated on every translator loop)
-	jumptbl->recordConditionalJumpEntry(C8_STATE::cpu.pc, C8_STATE::cpu.pc + 4, 2, (uint32_t *)(cache->getEndX86AddressCurrent() - 4)); // address is located at current x86 pc - 4 (relative takes up 4 bytes)
-
-	// Set region pc to current c8 pc
-	cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-	// Change C8 PC
-	C8_STATE::C8_incrementPC();
-}
-
-void Chip8Engine_Dynarec::handleOpcodeMSN_6() {
-	// Only one subtype of opcode in this branch
-	// 0x6XNN sets VX to NN
-	// TODO: check if correct
-	uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8;
-	uint8_t num = (C8_STATE::opcode & 0x00FF);
-	emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + vx, num);
-
-	// Set region pc to current c8 pc
-	cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-	C8_STATE::C8_incrementPC(); // Update PC by 2 bytes
-}
-
-void Chip8Engine_Dynarec::handleOpcodeMSN_7() {
-	// Only one subtype of opcode in this branch
-	// 0x7XNN adds NN to Vx
-	// TODO: check if correct
-	uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8;
-	uint8_t num = (C8_STATE::opcode & 0x00FF);
-	emitter->ADD_ImmtoM_8(C8_STATE::cpu.V + vx, num);
-
-	// Set region pc to current c8 pc
-	cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-	C8_STATE::C8_incrementPC(); // Update PC by 2 bytes
-}
-
 void Chip8Engine_Dynarec::handleOpcodeMSN_8() {
-	switch (C8_STATE::opcode & 0x000F) {
-	case 0x0000:
-	{
-		// 0x8XY0: Sets VX to the value of VY
-		// TODO: Check if correct
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 16 to get to a single base16 digit.
-		uint8_t vy = (C8_STATE::opcode & 0x00F0) >> 4; // Need to bit shift by 8 to get to a single base16 digit.
-		emitter->MOV_MtoR_8(al, C8_STATE::cpu.V + vy);
-		emitter->MOV_RtoM_8(C8_STATE::cpu.V + vx, al);
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Goto next opcode
-		break;
-	}
-	case 0x0001:
-	{
-		// 0x8XY1: Sets VX to VX OR VY
-		// TODO: Check if correct
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 16 to get to a single base16 digit.
-		uint8_t vy = (C8_STATE::opcode & 0x00F0) >> 4; // Need to bit shift by 8 to get to a single base16 digit.
-		emitter->MOV_MtoR_8(al, C8_STATE::cpu.V + vx);
-		emitter->OR_RwithM_8(al, C8_STATE::cpu.V + vy);
-		emitter->MOV_RtoM_8(C8_STATE::cpu.V + vx, al);
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Goto next opcode
-		break;
-	}
-	case 0x0002:
-	{
-		// 0x8XY2: Sets VX to VX AND VY
-		// TODO: Check if correct
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 16 to get to a single base16 digit.
-		uint8_t vy = (C8_STATE::opcode & 0x00F0) >> 4; // Need to bit shift by 8 to get to a single base16 digit.
-		emitter->MOV_MtoR_8(al, C8_STATE::cpu.V + vx);
-		emitter->AND_RwithM_8(al, C8_STATE::cpu.V + vy);
-		emitter->MOV_RtoM_8(C8_STATE::cpu.V + vx, al);
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Goto next opcode
-		break;
-	}
-	case 0x0003:
-	{
-		// 0x8XY3: Sets VX to VX XOR VY
-		// TODO: Check if correct
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 16 to get to a single base16 digit.
-		uint8_t vy = (C8_STATE::opcode & 0x00F0) >> 4; // Need to bit shift by 8 to get to a single base16 digit.
-		emitter->MOV_MtoR_8(al, C8_STATE::cpu.V + vx);
-		emitter->XOR_RwithM_8(al, C8_STATE::cpu.V + vy);
-		emitter->MOV_RtoM_8(C8_STATE::cpu.V + vx, al);
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Goto next opcode
-		break;
-	}
-	case 0x0004:
-	{
-		// 0x8XY4: Adds Vy to Vx, setting VF to 1 when there is a carry and 0 when theres not.
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 16 to get to a single base16 digit.
-		uint8_t vy = (C8_STATE::opcode & 0x00F0) >> 4; // Need to bit shift by 8 to get to a single base16 digit.
-		emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + 0xF, 0);
-		emitter->MOV_MtoR_8(al, C8_STATE::cpu.V + vx);
-		emitter->ADD_MtoR_8(al, C8_STATE::cpu.V + vy);
-		emitter->MOV_RtoM_8(C8_STATE::cpu.V + vx, al);
-		emitter->JNC_8(7); // Next instruction is 7 bytes long
-		emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + 0xF, 1);
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Goto next opcode
-		break;
-	}
-	case 0x0005:
-	{
-		// 0x8XY5: Vy is subtracted from Vx. VF set to 0 when theres a borrow, and 1 when there isnt.
-		// TODO: Check if correct
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 16 to get to a single base16 digit.
-		uint8_t vy = (C8_STATE::opcode & 0x00F0) >> 4; // Need to bit shift by 8 to get to a single base16 digit.
-		emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + 0xF, 1);
-		emitter->MOV_MtoR_8(al, C8_STATE::cpu.V + vx);
-		emitter->SUB_MfromR_8(al, C8_STATE::cpu.V + vy);
-		emitter->MOV_RtoM_8(C8_STATE::cpu.V + vx, al);
-		emitter->JNC_8(7); // Next instruction is 7 bytes long
-		emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + 0xF, 0);
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Goto next opcode
-		break;
-	}
-	case 0x0006:
-	{
-		// 0x8XY6: Shifts Vx right by one. VF is set to the LSB of Vx before the shift.
-		// TODO: Check if correct
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 16 to get to a single base16 digit.
-		emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + 0xF, 0);
-		emitter->MOV_MtoR_8(al, C8_STATE::cpu.V + vx);
-		emitter->SHR_R_8(al, 1);
-		emitter->MOV_RtoM_8(C8_STATE::cpu.V + vx, al);
-		emitter->JNC_8(7);
-		emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + 0xF, 1);
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Goto next opcode
-		break;
-	}
-	case 0x0007:
-	{
-		// 0x8XY7: Sets Vx to Vy minus Vx. VF is set to 0 when theres a borrow, and 1 where there isnt.
-		// TODO: Check if correct
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 16 to get to a single base16 digit.
-		uint8_t vy = (C8_STATE::opcode & 0x00F0) >> 4; // Need to bit shift by 8 to get to a single base16 digit.
-		emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + 0xF, 1);
-		emitter->MOV_MtoR_8(al, C8_STATE::cpu.V + vy);
-		emitter->SUB_MfromR_8(al, C8_STATE::cpu.V + vx);
-		emitter->MOV_RtoM_8(C8_STATE::cpu.V + vx, al);
-		emitter->JNC_8(7); // Next instruction is 7 bytes long
-		emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + 0xF, 0);
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Goto next opcode
-		break;
-	}
-	case 0x000E:
-	{
-		// 0x8XYE: Shifts Vx left by one. VF is set to the value of the MSB of Vx before the shift.
-		// TODO: Check if correct
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 16 to get to a single base16 digit.
-		emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + 0xF, 0);
-		emitter->MOV_MtoR_8(al, C8_STATE::cpu.V + vx);
-		emitter->SHL_R_8(al, 1);
-		emitter->MOV_RtoM_8(C8_STATE::cpu.V + vx, al);
-		emitter->JNC_8(7);
-		emitter->MOV_ImmtoM_8(C8_STATE::cpu.V + 0xF, 1);
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Goto next opcode
-		break;
-	}
-	default:
-	{
+	// The known opcodes (0x8XY0 -> 0x8XY7, 0x8XYE) are translated through the IR (see translateIRBlock), so only unknown ones get here.
 #ifdef USE_VERBOSE
-		char buffer[1000];
-		sprintf_s(buffer, 1000, "Unknown Opcode detected! Skipping (0x%.4X).", C8_STATE::opcode);
-		logMessage(LOGLEVEL::L_WARNING, buffer);
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Unknown Opcode detected! Skipping (0x%.4X).", C8_STATE::opcode);
+	logMessage(LOGLEVEL::L_WARNING, buffer);
 #endif
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
+	// Set region pc to current c8 pc
+	cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
 
-		C8_STATE::C8_incrementPC(); // Update PC by 2 bytes
-		break;
-	}
-	}
+	C8_STATE::C8_incrementPC(); // Update PC by 2 bytes
 }
 
 void Chip8Engine_Dynarec::handleOpcodeMSN_9() {
-	switch (C8_STATE::opcode & 0x000F) {
-	case 0x0000:
-	{
-		// 0x9XY0: Skips next instruction if register VX does not equal register VY
-		// TODO: Check if correct
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8;
-		uint8_t vy = (C8_STATE::opcode & 0x00F0) >> 4;
-
-		// Emit conditional code
-		emitter->MOV_MtoR_8(al, &C8_STATE::cpu.V[vx]);
-		emitter->MOV_MtoR_8(cl, &C8_STATE::cpu.V[vy]);
-		emitter->CMP_RwithR_8(al, cl);
-		emitter->JNE_32(0x00000000); // to fill in by jump table
-
-		// Record cond jump in table (so it will get updated on every translator loop)
-		jumptbl->recordConditionalJumpEntry(C8_STATE::cpu.pc, C8_STATE::cpu.pc + 4, 2, (uint32_t *)(cache->getEndX86AddressCurrent() - 4)); // address is located at current x86 pc - 4 (relative takes up 4 bytes)
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		// Change C8 PC
-		C8_STATE::C8_incrementPC();
-		break;
-	}
-	default:
-	{
+	// 0x9XY0 is translated through the IR (see translateIRBlock), so only unknown opcodes get here.
 #ifdef USE_VERBOSE
-		char buffer[1000];
-		sprintf_s(buffer, 1000, "Unknown Opcode detected! Skipping (0x%.4X).", C8_STATE::opcode);
-		logMessage(LOGLEVEL::L_WARNING, buffer);
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Unknown Opcode detected! Skipping (0x%.4X).", C8_STATE::opcode);
+	logMessage(LOGLEVEL::L_WARNING, buffer);
 #endif
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Update PC by 2 bytes
-		break;
-	}
-	}
-}
-
-void Chip8Engine_Dynarec::handleOpcodeMSN_A() {
-	// Only one subtype of opcode in this branch
-	// 0xANNN: Sets I to the address NNN
-	// TODO: Check if correct
-	emitter->MOV_ImmtoM_16(&C8_STATE::cpu.I, (C8_STATE::opcode & 0x0FFF));
-
 	// Set region pc to current c8 pc
 	cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
 
@@ -506,10 +455,14 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_B() {
 	// 0xBNNN: Sets PC to the address (NNN + V0) aka INDIRECT JUMP!
 
 	// Emit jump
-	// Need to determine jump location - move the num to register, then add v0 to it, then write back to the jump table.
-	// Need to also interrupt so we can determine the cache where the jump should lead to.
-	emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::PREPARE_FOR_INDIRECT_JUMP, C8_STATE::opcode);
-	emitter->JMP_M_PTR_32((uint32_t*)&jumptbl->x86_indirect_jump_address);
+	// Need to determine jump location - move the num to register, then add v0 to it, then jump through the dispatch table.
+	// Only interrupts (DISPATCH_MISS) when there is no cache starting at the jump location yet.
+	emitRegAllocExit();
+	emitter->XOR_RwithR_32(eax, eax); // clear eax register
+	emitter->MOV_MtoR_8(al, &C8_STATE::cpu.V[0]);
+	emitter->ADD_ImmtoR_32(eax, C8_STATE::opcode & 0x0FFF);
+	emitter->AND_RwithImm_32(eax, MEMORY_SZ - 1);
+	emitter->DYNAREC_EMIT_DISPATCH_JUMP();
 
 	// Set region pc to current c8 pc
 	cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
@@ -518,23 +471,6 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_B() {
 	Dynarec::block_finished = true;
 }
 
-void Chip8Engine_Dynarec::handleOpcodeMSN_C() {
-	// Only one subtype of opcode in this branch
-	// 0xCXNN: Sets Vx to the result of 0xNN & (random number)
-	// TODO: Check if correct.
-	uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 8 to get to a single base16 digit.
-	uint8_t opcodenum = C8_STATE::opcode & 0xFF; // Number from opcode.
-	emitter->RDTSC(); // eax will contain the lower 32 bits of the timestamp, which is random enough (pseudo-random)
-	emitter->AND_RwithImm_8(al, opcodenum);
-	emitter->MOV_RtoM_8(C8_STATE::cpu.V + vx, al);
-
-	// Set region pc to current c8 pc
-	cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-	// Change PC
-	C8_STATE::C8_incrementPC();
-}
-
 void Chip8Engine_Dynarec::handleOpcodeMSN_D() {
 	// Only one subtype of opcode in this branch
 	/* 0xDXYN:	Draws a sprite at coordinate (VX, VY) that has a width of 8 pixels and a height of N pixels.
@@ -542,8 +478,82 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_D() {
 				I value doesnt change after the execution of this instruction.
 				As described above, VF is set to 1 if any screen pixels are flipped from
 				set to unset when the sprite is drawn, and to 0 if that doesnt happen */
-	// TODO: check if correct.
-	emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::USE_INTERPRETER, C8_STATE::opcode);
+	// gfxmem is 1 bit per pixel (see GFX_ROW_SZ), so the sprite is drawn here instead of in the interpreter. Each sprite row is shifted right by (Vx & 7) into a 16-bit window (ah:al),
+	// which is XOR'ed into the 2 bytes of the screen row it covers. The pixels set in both before the XOR are collisions, OR'ed together into dl. Sprites wrap around the edges, same as the interpreter.
+	// ebx = row * 8 + first byte and edi = row * 8 + second byte (both wrap at GFX_MEMORY_SZ), esi = sprite data, cl = shift, ch = rows left.
+	uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8;
+	uint8_t vy = (C8_STATE::opcode & 0x00F0) >> 4;
+	uint8_t nrows = (C8_STATE::opcode & 0x000F);
+
+	if (nrows == 0) {
+		// Nothing to draw.
+		emitStoreVImm(0xF, 0);
+	}
+	else {
+		emitter->PUSH(ebx); // Holds V registers (see reg_alloc_c8_reg), restored before VF is stored.
+		emitter->PUSH(esi); // esi and edi are not saved by the cache setup.
+		emitter->PUSH(edi);
+
+		// x position: cl = shift, al = first byte of the row.
+		emitLoadV(al, vx);
+		emitter->MOV_RtoR_8(cl, al);
+		emitter->AND_RwithImm_8(cl, NUM_BITS_PER_BYTE - 1);
+		emitter->SHR_R_8(al, 3);
+		emitter->AND_RwithImm_8(al, GFX_ROW_SZ - 1);
+
+		// y position: dl = row * 8, the SHL wraps it to the 32 rows.
+		emitter->XOR_RwithR_32(edx, edx);
+		emitLoadV(dl, vy);
+		emitter->SHL_R_8(dl, 3);
+		emitter->ADD_RtoR_8(dl, al);
+		emitter->MOV_RtoR_32(ebx, edx);
+		emitter->ADD_ImmtoR_8(al, 1);
+		emitter->AND_RwithImm_8(al, GFX_ROW_SZ - 1);
+		emitter->AND_RwithImm_8(dl, (uint8_t)~(GFX_ROW_SZ - 1));
+		emitter->ADD_RtoR_8(dl, al);
+		emitter->MOV_RtoR_32(edi, edx);
+
+		// Sprite data at memory + I.
+		emitter->XOR_RwithR_32(eax, eax);
+		emitter->MOV_MtoR_16(ax, &C8_STATE::cpu.I);
+		emitter->ADD_ImmtoR_32(eax, (uint32_t)C8_STATE::memory);
+		emitter->MOV_RtoR_32(esi, eax);
+		emitter->MOV_ImmtoR_8(ch, nrows);
+		emitter->XOR_RwithR_32(edx, edx);
+
+		// Draw a row.
+		uint8_t * x86_loop_address = cache->getEndX86AddressCurrent();
+		emitter->XOR_RwithR_32(eax, eax);
+		emitter->MOV_PTRtoR_8(ah, esi);
+		emitter->SHR_R_16_CL(ax);
+		emitter->MOV_IdxMtoR_8(dh, C8_STATE::gfxmem, ebx);
+		emitter->AND_RwithR_8(dh, ah);
+		emitter->OR_RwithR_8(dl, dh);
+		emitter->XOR_RtoIdxM_8(C8_STATE::gfxmem, ebx, ah);
+		emitter->MOV_IdxMtoR_8(dh, C8_STATE::gfxmem, edi);
+		emitter->AND_RwithR_8(dh, al);
+		emitter->OR_RwithR_8(dl, dh);
+		emitter->XOR_RtoIdxM_8(C8_STATE::gfxmem, edi, al);
+
+		// Next row, until ch = 0.
+		emitter->ADD_ImmtoR_32(esi, 1);
+		emitter->ADD_ImmtoR_8(bl, GFX_ROW_SZ);
+		emitter->ADD_ImmtoR_32(edi, GFX_ROW_SZ);
+		emitter->AND_RwithImm_32(edi, GFX_MEMORY_SZ - 1);
+		emitter->SUB_ImmfromR_8(ch, 1);
+		emitter->JNE_8((int8_t)(x86_loop_address - (cache->getEndX86AddressCurrent() + 2))); // relative to the end of the JNE instruction (2 bytes)
+
+		// VF = 1 if there were any collisions (CF = 1 only when dl = 0).
+		emitter->CMP_RwithImm_8(dl, 1);
+		emitter->SETNC_R_8(dl);
+		emitter->POP(edi);
+		emitter->POP(esi);
+		emitter->POP(ebx);
+		emitStoreV(0xF, dl);
+	}
+
+	// Sets the draw flag and runs the speed limiter, which exits so the main loop can draw the frame.
+	emitter->DYNAREC_EMIT_HELPER_CALL(&X86_HELPERS::x86_helper_DRAW, X86_STATE::USE_INTERPRETER, C8_STATE::opcode);
 
 	// Set region pc to current c8 pc
 	cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
@@ -563,15 +573,11 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_E() {
 		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8;
 
 		// Emit conditional code
-		emitter->MOV_MtoR_8(cl, C8_STATE::cpu.V + vx);
 		emitter->MOV_ImmtoR_32(eax, (uint32_t)key->key);
-		emitter->ADD_RtoR_8(al, cl); // CAREFUL! No bounds checking, so cl must be less than 16 (dec) in order to stay in array bounds
+		emitter->ADD_RtoR_8(al, emitReadV(cl, vx)); // CAREFUL! No bounds checking, so Vx must be less than 16 (dec) in order to stay in array bounds
 		emitter->MOV_PTRtoR_8(dl, eax);
 		emitter->CMP_RwithImm_8(dl, 1);
-		emitter->JE_32(0x00000000); // to fill in by jump table
-
-		// Record cond jump in table (so it will get updated on every translator loop)
-		jumptbl->recordConditionalJumpEntry(C8_STATE::cpu.pc, C8_STATE::cpu.pc + 4, 2, (uint32_t *)(cache->getEndX86AddressCurrent() - 4)); // address is located at current x86 pc - 4 (relative takes up 4 bytes)
+		emitter->JE_Label(C8_STATE::cpu.pc + 4, isShortSkip(C8_STATE::cpu.pc + 2)); // bound when the translator reaches pc + 4
 
 		// Set region pc to current c8 pc
 		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
@@ -588,15 +594,11 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_E() {
 		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8;
 
 		// Emit conditional code
-		emitter->MOV_MtoR_8(cl, C8_STATE::cpu.V + vx);
 		emitter->MOV_ImmtoR_32(eax, (uint32_t)key->key);
-		emitter->ADD_RtoR_8(al, cl); // CAREFUL! No bounds checking, so cl must be less than 16 (dec) in order to stay in array bounds
+		emitter->ADD_RtoR_8(al, emitReadV(cl, vx)); // CAREFUL! No bounds checking, so Vx must be less than 16 (dec) in order to stay in array bounds
 		emitter->MOV_PTRtoR_8(dl, eax);
 		emitter->CMP_RwithImm_8(dl, 0);
-		emitter->JE_32(0x00000000); // to fill in by jump table
-
-		// Record cond jump in table (so it will get updated on every translator loop)
-		jumptbl->recordConditionalJumpEntry(C8_STATE::cpu.pc, C8_STATE::cpu.pc + 4, 2, (uint32_t *)(cache->getEndX86AddressCurrent() - 4)); // address is located at current x86 pc - 4 (relative takes up 4 bytes)
+		emitter->JE_Label(C8_STATE::cpu.pc + 4, isShortSkip(C8_STATE::cpu.pc + 2)); // bound when the translator reaches pc + 4
 
 		// Set region pc to current c8 pc
 		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
@@ -627,7 +629,7 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_F() {
 	{
 		// 0xFX07: Sets Vx to the value of the delay timer.
 		// TODO: check if correct.
-		emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::UPDATE_TIMERS, C8_STATE::opcode);
+		emitter->DYNAREC_EMIT_HELPER_CALL(&X86_HELPERS::x86_helper_UPDATE_TIMERS, X86_STATE::UPDATE_TIMERS, C8_STATE::opcode);
 
 		// Set region pc to current c8 pc
 		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
@@ -641,9 +643,9 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_F() {
 		// TODO: Check if correct.
 		// check if in sync
 		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 8 to get to a single base16 digit.
-		emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::WAIT_FOR_KEYPRESS, C8_STATE::opcode); // This will put the key (single value from 0x0 to 0xF) in key->x86_key_pressed
+		emitter->DYNAREC_EMIT_HELPER_CALL(&X86_HELPERS::x86_helper_WAIT_FOR_KEYPRESS, X86_STATE::WAIT_FOR_KEYPRESS, C8_STATE::opcode); // This will put the key (single value from 0x0 to 0xF) in key->x86_key_pressed
 		emitter->MOV_MtoR_8(al, &key->X86_KEY_PRESSED);
-		emitter->MOV_RtoM_8(C8_STATE::cpu.V + vx, al);
+		emitStoreV(vx, al);
 
 		// Set region pc to current c8 pc
 		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
@@ -655,7 +657,7 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_F() {
 	{
 		// 0xFX15: Sets the delay timer to Vx.
 		// TODO: check if correct.
-		emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::UPDATE_TIMERS, C8_STATE::opcode);
+		emitter->DYNAREC_EMIT_HELPER_CALL(&X86_HELPERS::x86_helper_UPDATE_TIMERS, X86_STATE::UPDATE_TIMERS, C8_STATE::opcode);
 
 		// Set region pc to current c8 pc
 		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
@@ -667,42 +669,7 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_F() {
 	{
 		// 0xFX18: Sets the sound timer to Vx.
 		// TODO: check if correct.
-		emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::UPDATE_TIMERS, C8_STATE::opcode);
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Update PC by 2 bytes
-		break;
-	}
-	case 0x001E:
-	{
-		// 0xFX1E: Adds Vx to I.
-		// TODO: check if correct.
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 8 to get to a single base16 digit.
-		emitter->MOV_MtoR_16(ax, &C8_STATE::cpu.I);
-		// Cant just use add_MtoR_8 here as if it goes over 0xFF in al, the carry is not added on to the ax register.
-		emitter->XOR_RwithR_32(ecx, ecx); // clear ecx register
-		emitter->MOV_MtoR_8(cl, C8_STATE::cpu.V + vx);
-		emitter->ADD_RtoR_16(ax, cx);
-		emitter->MOV_RtoM_16(&C8_STATE::cpu.I, ax);
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		C8_STATE::C8_incrementPC(); // Update PC by 2 bytes
-		break;
-	}
-	case 0x0029:
-	{
-		// 0xFX29: Sets I to the location of the sprite for the character in Vx. Chars 0-F (in hex) are represented by a 4x5 font.
-		//         ie: if V[x] = 0xA, set I to location of A in font sheet. Note that sprites are 8-bits wide, while fonts are 4-bits, so
-		//             the 4-bits at the end are padded (0's).
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 8 to get to a single base16 digit.
-		emitter->MOV_MtoR_8(al, C8_STATE::cpu.V + vx);
-		emitter->MOV_ImmtoR_8(cl, 5); // 5 = width constant of fonts
-		emitter->MUL_RwithR_8(cl);
-		emitter->MOV_RtoM_16(&C8_STATE::cpu.I, ax);
+		emitter->DYNAREC_EMIT_HELPER_CALL(&X86_HELPERS::x86_helper_UPDATE_TIMERS, X86_STATE::UPDATE_TIMERS, C8_STATE::opcode);
 
 		// Set region pc to current c8 pc
 		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
@@ -717,15 +684,15 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_F() {
 		//emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::USE_INTERPRETER, C8_STATE::opcode);
 		//emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::DEBUG, C8_STATE::opcode);
 
-		// This is self modifying code! Invalidate cache that the memory writes to
-		emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::SELF_MODIFYING_CODE, C8_STATE::opcode);
+		// This may be self modifying code! Invalidate cache that the memory writes to (interrupt only happens if I -> I+2 has been translated)
+		emitter->DYNAREC_EMIT_SMC_CHECK(C8_STATE::opcode, 3);
 
 		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 8 to get to a single base16 digit.
 		emitter->XOR_RwithR_32(eax, eax); // clear eax register
 		// Move the address from I into register edx (= starting address of memory array + offset from I)
 		emitter->MOV_ImmtoR_32(edx, (uint32_t)C8_STATE::memory);
 		emitter->ADD_MtoR_16(dx, &C8_STATE::cpu.I);
-		emitter->MOV_MtoR_8(al, C8_STATE::cpu.V + vx); // Move Vx value into al
+		emitLoadV(al, vx); // Move Vx value into al
 		// Start with 100's
 		emitter->MOV_ImmtoR_8(cl, 100); // Move 100 value into cl
 		emitter->DIV_RwithR_8(cl); // Result is in AX register. AX = al/cl, quotient in al, remainder in ah
@@ -742,6 +709,9 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_F() {
 		// Dont need to divide, as its by 1!
 		emitter->MOV_RtoPTR_8(edx, al); // Move result to Mem+I+2 (ptr in edx)
 
+		// The opcode after a self modifying code check needs a recorded offset, as that is where the cache gets truncated (see CacheHandler::truncateCacheByIndex).
+		Dynarec::reg_alloc_block_start = true;
+
 		// Set region pc to current c8 pc
 		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
 
@@ -753,10 +723,14 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_F() {
 	{
 		// 0xFX55: Copies all current values in registers V0 -> Vx to memory starting at address I.
 
-		// This is self modifying code! Invalidate cache that the memory writes to
-		emitter->DYNAREC_EMIT_INTERRUPT(X86_STATE::SELF_MODIFYING_CODE, C8_STATE::opcode);
-
 		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 8 to get to a single base16 digit.
+
+		// This may be self modifying code! Invalidate cache that the memory writes to (interrupt only happens if I -> I+X has been translated)
+		emitter->DYNAREC_EMIT_SMC_CHECK(C8_STATE::opcode, vx + 1);
+
+		// The loop reads the V registers from memory.
+		emitter->DYNAREC_EMIT_REG_ALLOC_WRITE_BACK();
+
 		// Setup loop
 		// Move the address from I into register eax (= starting address of memory array + offset from I)
 		emitter->MOV_ImmtoR_32(eax, (uint32_t)C8_STATE::memory);
@@ -773,6 +747,9 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_F() {
 		emitter->CMP_RwithImm_32(edx, (uint32_t)(C8_STATE::cpu.V + vx + 1)); // "less than" compare
 		emitter->JNE_8(-18); // jump to start of loop -(2+6+3+3+2+2) = -18
 
+		// Same as 0xFX33.
+		Dynarec::reg_alloc_block_start = true;
+
 		 // Set region pc to current c8 pc
 		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
 
@@ -780,35 +757,6 @@ void Chip8Engine_Dynarec::handleOpcodeMSN_F() {
 		C8_STATE::C8_incrementPC();
 		break;
 	}
-	case 0x0065:
-	{
-		// 0xFX65: Copies memory starting from address I to all registers V0 -> Vx.
-		// TODO: check if correct.
-
-		uint8_t vx = (C8_STATE::opcode & 0x0F00) >> 8; // Need to bit shift by 8 to get to a single base16 digit.
-		// Setup loop
-		// Move the address from I into register eax (= starting address of memory array + offset from I)
-		emitter->MOV_ImmtoR_32(eax, (uint32_t)C8_STATE::memory);
-		emitter->ADD_MtoR_16(ax, &C8_STATE::cpu.I);
-		// Move address of V[0] into edx register
-		emitter->MOV_ImmtoR_32(edx, (uint32_t)C8_STATE::cpu.V);
-		// Start loop
-		emitter->MOV_PTRtoR_8(cl, eax); // Move 8bit value from PTR @ eax (c8 memory + I register + loop number) into cl register
-		emitter->MOV_RtoPTR_8(edx, cl); // Move 8bit value from cl register into PTR @ edx (c8 V address + loop number)
-		// Add one to each PTR to increment address
-		emitter->ADD_ImmtoR_8(eax, 1);
-		emitter->ADD_ImmtoR_8(edx, 1);
-		// Compare edx with final V address (to stop loop)
-		emitter->CMP_RwithImm_32(edx, (uint32_t)(C8_STATE::cpu.V + vx + 1)); // "less than" compare
-		emitter->JNE_8(-18); // jump to start of loop -(2+6+3+3+2+2) = -18
-
-		// Set region pc to current c8 pc
-		cache->setCacheEndC8PCCurrent(C8_STATE::cpu.pc);
-
-		// Increment PC
-		C8_STATE::C8_incrementPC();
-		break;
-	}
 	default:
 	{
 #ifdef USE_VERBOSE
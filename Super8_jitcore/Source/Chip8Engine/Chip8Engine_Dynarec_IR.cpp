@@ -0,0 +1,271 @@
+#include "stdafx.h"
+
+#include <cstdint>
+
+#include "Headers\Globals.h"
+
+#include "Headers\Chip8Globals\Chip8Globals.h"
+#include "Headers\Chip8Engine\Chip8Engine_Dynarec.h"
+#include "Headers\Chip8Engine\Chip8Engine_IR.h"
+#include "Headers\Chip8Engine\Chip8Engine_CodeEmitter_x86.h"
+#include "Headers\Chip8Engine\Chip8Engine_CacheHandler.h"
+
+using namespace Chip8Globals;
+
+void Chip8Engine_Dynarec::translateIRBlock()
+{
+	uint16_t c8_start_pc = C8_STATE::cpu.pc;
+	ir->beginBlock(c8_start_pc);
+	ir->decodeOpcode(C8_STATE::opcode);
+
+#if !defined(USE_DEBUG_EXTRA) && !defined(LIMIT_SPEED_BY_INSTRUCTIONS)
+	// Add the opcodes after it, until one which has no IR form or has to start at its own x86 offset. (An extra interrupt is emitted around every opcode otherwise, so blocks are only one opcode long.)
+	while (true) {
+		uint16_t c8_pc = c8_start_pc + ir->block.count * 2;
+		if (c8_pc > C8_STATE::rom_sz || c8_pc + 1 >= MEMORY_SZ) break; // Same as the translator loop bounds check.
+		if (emitter->getUnboundLabelCount() > 0) break; // A skip from before the block lands on the code of this opcode.
+		if (Dynarec::inline_return_pc == NO_INLINE_RETURN && isLoopHead(c8_pc)) break; // Starts a register allocation block and is aligned by the translator loop.
+		if (cache->getFreeX86SpaceCurrent() < (ir->block.count + 1) * IR_INSTR_X86_SZ + MAX_OPCODE_X86_SZ) break; // The translator loop can only continue in a new cache between blocks.
+		uint16_t opcode = C8_STATE::memory[c8_pc] << 8 | C8_STATE::memory[c8_pc + 1];
+		if (!ir->decodeOpcode(opcode)) break;
+	}
+#endif
+
+	// Keep the opcode offsets in step (see CacheHandler::truncateCacheByIndex). Passes work across the whole block, so only the first opcode (recorded by the translator loop) can be an entry or truncation point.
+	for (uint8_t i = 1; i < ir->block.count; i++) cache->recordOpcodeX86OffsetNoneCurrent(c8_start_pc + i * 2);
+
+	ir->runPasses();
+#ifdef USE_DEBUG
+	ir->DEBUG_printBlock();
+#endif
+	lowerIRBlock();
+
+	// Set region pc to the last opcode in the block
+	cache->setCacheEndC8PCCurrent(c8_start_pc + (ir->block.count - 1) * 2);
+
+	// Change C8 PC, and count the opcodes after the first (the translator loop counts that one).
+	C8_STATE::C8_incrementPC(ir->block.count * 2);
+	translate_cycles += ir->block.count - 1;
+	Dynarec::block_opcode_count += ir->block.count - 1;
+}
+
+void Chip8Engine_Dynarec::lowerIRBlock()
+{
+	IR_BLOCK * block = &ir->block;
+	uint8_t * x86_skip_jumps[IR_MAX_BLOCK_INSTRS + 1] = { NULL }; // Jump of a skip inside the block, by the index of the instruction it lands on.
+
+	for (uint8_t i = 0; i < block->count; i++) {
+		// A skip over the previous instruction lands here.
+		if (x86_skip_jumps[i] != NULL) *(int8_t *)(x86_skip_jumps[i] + 1) = (int8_t)(cache->getEndX86AddressCurrent() - (x86_skip_jumps[i] + 2));
+
+		IR_INSTR * instr = &block->instrs[i];
+		if (!Chip8Engine_IR::isSkipOp(instr->op)) {
+			lowerIRInstr(instr);
+			continue;
+		}
+
+		bool skip_if_equal = (instr->op == IR_SKIP_EQ_IMM || instr->op == IR_SKIP_EQ);
+		if (i + 1 == block->count) {
+			// The skipped opcode is not in the block, so its code size is not known yet.
+			lowerIRSkipCompare(instr, al, cl);
+			if (skip_if_equal) emitter->JE_Label(instr->c8_pc + 4, isShortSkip(instr->c8_pc + 2)); // bound when the translator reaches pc + 4
+			else emitter->JNE_Label(instr->c8_pc + 4, isShortSkip(instr->c8_pc + 2));
+		}
+		else if (canIfConvertIR(&block->instrs[i + 1]) && (i == 0 || !Chip8Engine_IR::isSkipOp(block->instrs[i - 1].op))) {
+			// Not when this skip is skipped itself, as that has to land on the code of the next instruction.
+			lowerIRIfConversion(instr, &block->instrs[i + 1]);
+			i++;
+		}
+		else {
+			lowerIRSkipCompare(instr, al, cl);
+			x86_skip_jumps[i + 2] = cache->getEndX86AddressCurrent();
+			// Relative value is filled in when the instruction after the skipped one is reached (every instruction is less than IR_INSTR_X86_SZ bytes).
+			if (skip_if_equal) emitter->JE_8(0);
+			else emitter->JNE_8(0);
+		}
+	}
+
+	// A skip over the last instruction lands after the block.
+	if (x86_skip_jumps[block->count] != NULL) *(int8_t *)(x86_skip_jumps[block->count] + 1) = (int8_t)(cache->getEndX86AddressCurrent() - (x86_skip_jumps[block->count] + 2));
+}
+
+void Chip8Engine_Dynarec::lowerIRInstr(IR_INSTR * instr)
+{
+	switch (instr->op) {
+	case IR_NOP:
+		break;
+	case IR_LOAD_IMM:
+		emitStoreVImm(instr->x, (uint8_t)instr->imm);
+		if (instr->flags & IR_FLAG_VF_OUT) emitStoreVImm(0xF, instr->y);
+		break;
+	case IR_ADD_IMM:
+		if (emitter->isRegAllocated(instr->x)) emitter->ADD_ImmtoR_8(emitter->getRegAllocX86Register(instr->x), (uint8_t)instr->imm);
+		else emitter->ADD_ImmtoM_8(C8_STATE::cpu.V + instr->x, (uint8_t)instr->imm);
+		break;
+	case IR_MOV:
+		emitStoreV(instr->x, emitReadV(al, instr->y));
+		break;
+	case IR_OR:
+	case IR_AND:
+	case IR_XOR:
+	{
+		X86Register x86_vx = emitReadV(al, instr->x);
+		X86Register x86_vy = emitReadV(cl, instr->y);
+		if (instr->op == IR_OR) emitter->OR_RwithR_8(x86_vx, x86_vy);
+		else if (instr->op == IR_AND) emitter->AND_RwithR_8(x86_vx, x86_vy);
+		else emitter->XOR_RwithR_8(x86_vx, x86_vy);
+		emitStoreV(instr->x, x86_vx);
+		break;
+	}
+	case IR_ADD:
+	{
+		// VF is 1 when there is a carry.
+		X86Register x86_vx = emitReadV(al, instr->x);
+		emitter->ADD_RtoR_8(x86_vx, emitReadV(cl, instr->y));
+		lowerIRFlagResult(instr, x86_vx, true);
+		break;
+	}
+	case IR_SUB:
+	{
+		// VF is 0 when there is a borrow.
+		X86Register x86_vx = emitReadV(al, instr->x);
+		emitter->SUB_RfromR_8(x86_vx, emitReadV(cl, instr->y));
+		lowerIRFlagResult(instr, x86_vx, false);
+		break;
+	}
+	case IR_SUBN:
+	{
+		emitLoadV(al, instr->y);
+		emitter->SUB_RfromR_8(al, emitReadV(cl, instr->x));
+		lowerIRFlagResult(instr, al, false);
+		break;
+	}
+	case IR_SHR:
+	case IR_SHL:
+	{
+		// VF is the bit shifted out.
+		X86Register x86_vx = emitReadV(al, instr->x);
+		if (instr->op == IR_SHR) emitter->SHR_R_8(x86_vx, 1);
+		else emitter->SHL_R_8(x86_vx, 1);
+		lowerIRFlagResult(instr, x86_vx, true);
+		break;
+	}
+	case IR_RAND:
+		emitter->RDTSC(); // eax will contain the lower 32 bits of the timestamp, which is random enough (pseudo-random)
+		emitter->AND_RwithImm_8(al, (uint8_t)instr->imm);
+		emitStoreV(instr->x, al);
+		break;
+	case IR_SET_I:
+		emitter->MOV_ImmtoM_16(&C8_STATE::cpu.I, instr->imm);
+		break;
+	case IR_ADD_I:
+		emitter->MOV_MtoR_16(ax, &C8_STATE::cpu.I);
+		// Cant just use add_MtoR_8 here as if it goes over 0xFF in al, the carry is not added on to the ax register.
+		emitter->XOR_RwithR_32(ecx, ecx); // clear ecx register
+		emitLoadV(cl, instr->x);
+		emitter->ADD_RtoR_16(ax, cx);
+		emitter->MOV_RtoM_16(&C8_STATE::cpu.I, ax);
+		break;
+	case IR_FONT_I:
+		emitLoadV(al, instr->x);
+		emitter->MOV_ImmtoR_8(cl, 5); // 5 = width constant of fonts
+		emitter->MUL_RwithR_8(cl);
+		emitter->MOV_RtoM_16(&C8_STATE::cpu.I, ax);
+		break;
+	case IR_LOAD_MEM:
+		// The loop writes the V registers in memory, so write back first (for the ones after Vx) and load again after.
+		emitter->DYNAREC_EMIT_REG_ALLOC_WRITE_BACK();
+
+		// Setup loop
+		// Move the address from I into register eax (= starting address of memory array + offset from I)
+		emitter->MOV_ImmtoR_32(eax, (uint32_t)C8_STATE::memory);
+		emitter->ADD_MtoR_16(ax, &C8_STATE::cpu.I);
+		// Move address of V[0] into edx register
+		emitter->MOV_ImmtoR_32(edx, (uint32_t)C8_STATE::cpu.V);
+		// Start loop
+		emitter->MOV_PTRtoR_8(cl, eax); // Move 8bit value from PTR @ eax (c8 memory + I register + loop number) into cl register
+		emitter->MOV_RtoPTR_8(edx, cl); // Move 8bit value from cl register into PTR @ edx (c8 V address + loop number)
+		// Add one to each PTR to increment address
+		emitter->ADD_ImmtoR_8(eax, 1);
+		emitter->ADD_ImmtoR_8(edx, 1);
+		// Compare edx with final V address (to stop loop)
+		emitter->CMP_RwithImm_32(edx, (uint32_t)(C8_STATE::cpu.V + instr->x + 1)); // "less than" compare
+		emitter->JNE_8(-18); // jump to start of loop -(2+6+3+3+2+2) = -18
+		emitter->DYNAREC_EMIT_REG_ALLOC_LOADS();
+		break;
+	default:
+		break;
+	}
+}
+
+void Chip8Engine_Dynarec::lowerIRFlagResult(IR_INSTR * instr, X86Register x86_result, bool vf_is_carry)
+{
+	// The MOVs do not change CF, so it is read straight into dl without a branch. VF is stored last, so it ends up as the flag when Vx is VF.
+	if (instr->flags & IR_FLAG_VF_OUT) {
+		if (vf_is_carry) emitter->SETC_R_8(dl);
+		else emitter->SETNC_R_8(dl);
+	}
+	emitStoreV(instr->x, x86_result);
+	if (instr->flags & IR_FLAG_VF_OUT) emitStoreV(0xF, dl);
+}
+
+void Chip8Engine_Dynarec::lowerIRSkipCompare(IR_INSTR * instr, X86Register scratch_x, X86Register scratch_y)
+{
+	X86Register x86_vx = emitReadV(scratch_x, instr->x);
+	if (instr->op == IR_SKIP_EQ_IMM || instr->op == IR_SKIP_NE_IMM) emitter->CMP_RwithImm_8(x86_vx, (uint8_t)instr->imm);
+	else emitter->CMP_RwithR_8(x86_vx, emitReadV(scratch_y, instr->y));
+}
+
+bool Chip8Engine_Dynarec::canIfConvertIR(IR_INSTR * skipped)
+{
+	switch (skipped->op) {
+	case IR_LOAD_IMM:
+		return !(skipped->flags & IR_FLAG_VF_OUT); // Also sets VF.
+	case IR_ADD_IMM:
+	case IR_MOV:
+	case IR_OR:
+	case IR_AND:
+	case IR_XOR:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void Chip8Engine_Dynarec::lowerIRIfConversion(IR_INSTR * skip, IR_INSTR * skipped)
+{
+	// al = current Vx, cl = Vx after the skipped instruction.
+	emitLoadV(al, skipped->x);
+	switch (skipped->op) {
+	case IR_LOAD_IMM:
+		emitter->MOV_ImmtoR_8(cl, (uint8_t)skipped->imm);
+		break;
+	case IR_ADD_IMM:
+		emitter->MOV_ImmtoR_8(cl, (uint8_t)skipped->imm);
+		emitter->ADD_RtoR_8(cl, al);
+		break;
+	case IR_MOV:
+		emitLoadV(cl, skipped->y);
+		break;
+	case IR_OR:
+		emitLoadV(cl, skipped->y);
+		emitter->OR_RwithR_8(cl, al);
+		break;
+	case IR_AND:
+		emitLoadV(cl, skipped->y);
+		emitter->AND_RwithR_8(cl, al);
+		break;
+	case IR_XOR:
+		emitLoadV(cl, skipped->y);
+		emitter->XOR_RwithR_8(cl, al);
+		break;
+	default:
+		break;
+	}
+
+	// The skipped instruction only happens when the skip is not taken.
+	lowerIRSkipCompare(skip, dl, dh);
+	if (skip->op == IR_SKIP_EQ_IMM || skip->op == IR_SKIP_EQ) emitter->CMOVNE_RwithR_32(eax, ecx);
+	else emitter->CMOVE_RwithR_32(eax, ecx);
+	emitStoreV(skipped->x, al);
+}
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "stdafx.h"
+
+#include <cstdint>
+
+#ifdef USE_IR_PASS_TIMING
+#include <SDL.h>
+#endif
+
+#include "Headers\Globals.h"
+
+#include "Headers\Chip8Engine\Chip8Engine_IR.h"
+
+Chip8Engine_IR::Chip8Engine_IR()
+{
+	// Register this component in logger
+	logger->registerComponent(this);
+
+	block.count = 0;
+	block.c8_start_pc = 0;
+	num_passes = 0;
+
+	registerPass("ConstantFolding", &passConstantFolding);
+	registerPass("DeadFlags", &passDeadFlags);
+	registerPass("DeadStores", &passDeadStores);
+}
+
+Chip8Engine_IR::~Chip8Engine_IR()
+{
+#ifdef USE_IR_PASS_TIMING
+	DEBUG_printPassTimes();
+#endif
+
+	// Deregister this component in logger
+	logger->deregisterComponent(this);
+}
+
+std::string Chip8Engine_IR::getComponentName()
+{
+	return std::string("IR");
+}
+
+void Chip8Engine_IR::beginBlock(uint16_t c8_start_pc)
+{
+	block.count = 0;
+	block.c8_start_pc = c8_start_pc;
+}
+
+bool Chip8Engine_IR::hasIRForm(uint16_t c8_opcode)
+{
+	switch (c8_opcode & 0xF000) {
+	case 0x3000: case 0x4000: case 0x5000: case 0x6000: case 0x7000: case 0xA000: case 0xC000:
+		return true;
+	case 0x8000:
+		return ((c8_opcode & 0x000F) <= 0x0007 || (c8_opcode & 0x000F) == 0x000E);
+	case 0x9000:
+		return ((c8_opcode & 0x000F) == 0x0000);
+	case 0xF000:
+		return ((c8_opcode & 0x00FF) == 0x001E || (c8_opcode & 0x00FF) == 0x0029 || (c8_opcode & 0x00FF) == 0x0065);
+	default:
+		return false;
+	}
+}
+
+bool Chip8Engine_IR::isSkipOp(IR_OP op)
+{
+	return (op == IR_SKIP_EQ_IMM || op == IR_SKIP_NE_IMM || op == IR_SKIP_EQ || op == IR_SKIP_NE);
+}
+
+bool Chip8Engine_IR::decodeOpcode(uint16_t c8_opcode)
+{
+	if (block.count >= IR_MAX_BLOCK_INSTRS || !hasIRForm(c8_opcode)) return false;
+
+	IR_INSTR * instr = &block.instrs[block.count];
+	instr->x = (c8_opcode & 0x0F00) >> 8;
+	instr->y = (c8_opcode & 0x00F0) >> 4;
+	instr->flags = 0;
+	instr->imm = (c8_opcode & 0x00FF);
+	instr->c8_pc = block.c8_start_pc + block.count * 2;
+
+	switch (c8_opcode & 0xF000) {
+	case 0x3000:
+		instr->op = IR_SKIP_EQ_IMM;
+		break;
+	case 0x4000:
+		instr->op = IR_SKIP_NE_IMM;
+		break;
+	case 0x5000:
+		instr->op = IR_SKIP_EQ;
+		break;
+	case 0x6000:
+		instr->op = IR_LOAD_IMM;
+		break;
+	case 0x7000:
+		instr->op = IR_ADD_IMM;
+		break;
+	case 0x8000:
+		switch (c8_opcode & 0x000F) {
+		case 0x0000:
+			instr->op = IR_MOV;
+			break;
+		case 0x0001:
+			instr->op = IR_OR;
+			break;
+		case 0x0002:
+			instr->op = IR_AND;
+			break;
+		case 0x0003:
+			instr->op = IR_XOR;
+			break;
+		case 0x0004:
+			instr->op = IR_ADD;
+			instr->flags = IR_FLAG_VF_OUT;
+			break;
+		case 0x0005:
+			instr->op = IR_SUB;
+			instr->flags = IR_FLAG_VF_OUT;
+			break;
+		case 0x0006:
+			instr->op = IR_SHR;
+			instr->flags = IR_FLAG_VF_OUT;
+			break;
+		case 0x0007:
+			instr->op = IR_SUBN;
+			instr->flags = IR_FLAG_VF_OUT;
+			break;
+		case 0x000E:
+			instr->op = IR_SHL;
+			instr->flags = IR_FLAG_VF_OUT;
+			break;
+		}
+		break;
+	case 0x9000:
+		instr->op = IR_SKIP_NE;
+		break;
+	case 0xA000:
+		instr->op = IR_SET_I;
+		instr->imm = (c8_opcode & 0x0FFF);
+		break;
+	case 0xC000:
+		instr->op = IR_RAND;
+		break;
+	case 0xF000:
+		switch (c8_opcode & 0x00FF) {
+		case 0x001E:
+			instr->op = IR_ADD_I;
+			break;
+		case 0x0029:
+			instr->op = IR_FONT_I;
+			break;
+		case 0x0065:
+			instr->op = IR_LOAD_MEM;
+			break;
+		}
+		break;
+	}
+
+	block.count++;
+	return true;
+}
+
+void Chip8Engine_IR::registerPass(const char * name, IR_PASS_FUNC func)
+{
+	if (num_passes >= IR_MAX_PASSES) {
+		char buffer[1000];
+		sprintf_s(buffer, 1000, "Too many IR passes! Could not register %s. Exiting.", name);
+		logMessage(LOGLEVEL::L_FATAL, buffer);
+		exit(2);
+	}
+	passes[num_passes].name = name;
+	passes[num_passes].func = func;
+	passes[num_passes].ticks = 0;
+	passes[num_passes].runs = 0;
+	num_passes++;
+}
+
+void Chip8Engine_IR::runPasses()
+{
+	for (uint8_t i = 0; i < num_passes; i++) {
+#ifdef USE_IR_PASS_TIMING
+		uint64_t start_ticks = SDL_GetPerformanceCounter();
+		passes[i].func(&block);
+		passes[i].ticks += SDL_GetPerformanceCounter() - start_ticks;
+		passes[i].runs++;
+#else
+		passes[i].func(&block);
+#endif
+	}
+}
+
+#ifdef USE_DEBUG
+void Chip8Engine_IR::DEBUG_printBlock()
+{
+	static const char * op_names[] = { "NOP", "LOAD_IMM", "ADD_IMM", "MOV", "OR", "AND", "XOR", "ADD", "SUB", "SUBN", "SHR", "SHL", "RAND",
+		"SET_I", "ADD_I", "FONT_I", "LOAD_MEM", "SKIP_EQ_IMM", "SKIP_NE_IMM", "SKIP_EQ", "SKIP_NE" };
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "IR block at c8 pc 0x%.4X, %d instructions:", block.c8_start_pc, block.count);
+	logMessage(LOGLEVEL::L_DEBUG, buffer);
+	for (uint8_t i = 0; i < block.count; i++) {
+		IR_INSTR * instr = &block.instrs[i];
+		sprintf_s(buffer, 1000, " 0x%.4X: %s x = %X, y = %X, imm = 0x%.3X, flags = 0x%.2X", instr->c8_pc, op_names[instr->op], instr->x, instr->y, instr->imm, instr->flags);
+		logMessage(LOGLEVEL::L_DEBUG, buffer);
+	}
+}
+#endif
+
+#ifdef USE_IR_PASS_TIMING
+void Chip8Engine_IR::DEBUG_printPassTimes()
+{
+	char buffer[1000];
+	double us_per_tick = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+	for (uint8_t i = 0; i < num_passes; i++) {
+		double total_us = (double)passes[i].ticks * us_per_tick;
+		sprintf_s(buffer, 1000, "IR pass %s: %d runs, %.1f us total, %.3f us per block.", passes[i].name, passes[i].runs, total_us, (passes[i].runs > 0) ? total_us / passes[i].runs : 0.0);
+		logMessage(LOGLEVEL::L_INFO, buffer);
+	}
+}
+#endif
\ No newline at end of file
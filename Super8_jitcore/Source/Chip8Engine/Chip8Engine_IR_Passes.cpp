@@ -0,0 +1,291 @@
+#include "stdafx.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "Headers\Globals.h"
+
+#include "Headers\Chip8Engine\Chip8Engine_IR.h"
+
+#define IR_REG_I 16 // Bit of I in the register masks below, after V0 -> VF.
+
+void Chip8Engine_IR::passConstantFolding(IR_BLOCK * block)
+{
+	uint32_t known = 0; // Mask of the registers with a known value.
+	uint16_t values[IR_REG_I + 1];
+
+	for (uint8_t i = 0; i < block->count; i++) {
+		IR_INSTR * instr = &block->instrs[i];
+		uint8_t vx = instr->x;
+		uint8_t vy = instr->y;
+		bool vx_known = ((known & (1 << vx)) != 0);
+		bool vy_known = ((known & (1 << vy)) != 0);
+
+		// An instruction after a skip only runs some of the time, so afterwards only the values which are the same either way are known.
+		bool skipped = (i > 0 && isSkipOp(block->instrs[i - 1].op));
+		uint32_t known_before = known;
+		uint16_t values_before[IR_REG_I + 1];
+		if (skipped) memcpy(values_before, values, sizeof(values));
+
+		switch (instr->op) {
+		case IR_LOAD_IMM:
+			known |= (1 << vx);
+			values[vx] = instr->imm;
+			if (instr->flags & IR_FLAG_VF_OUT) {
+				known |= (1 << 0xF);
+				values[0xF] = instr->y;
+			}
+			break;
+		case IR_ADD_IMM:
+			if (vx_known) {
+				instr->op = IR_LOAD_IMM;
+				instr->imm = (values[vx] + instr->imm) & 0xFF;
+				values[vx] = instr->imm;
+			}
+			break;
+		case IR_MOV:
+		case IR_OR:
+		case IR_AND:
+		case IR_XOR:
+			if ((vx_known || instr->op == IR_MOV) && vy_known) {
+				uint16_t result = values[vy];
+				if (instr->op == IR_OR) result = values[vx] | values[vy];
+				else if (instr->op == IR_AND) result = values[vx] & values[vy];
+				else if (instr->op == IR_XOR) result = values[vx] ^ values[vy];
+				instr->op = IR_LOAD_IMM;
+				instr->imm = result;
+				known |= (1 << vx);
+				values[vx] = result;
+			}
+			else if (instr->op == IR_XOR && vx == vy) {
+				// Always 0, whatever Vx is.
+				instr->op = IR_LOAD_IMM;
+				instr->imm = 0;
+				known |= (1 << vx);
+				values[vx] = 0;
+			}
+			else {
+				known &= ~(1 << vx);
+			}
+			break;
+		case IR_ADD:
+		case IR_SUB:
+		case IR_SUBN:
+		case IR_SHR:
+		case IR_SHL:
+		{
+			// VF is written after Vx, same as the IR_LOAD_IMM it is folded into.
+			bool uses_vy = (instr->op == IR_ADD || instr->op == IR_SUB || instr->op == IR_SUBN);
+			bool flag_out = ((instr->flags & IR_FLAG_VF_OUT) != 0);
+			if (!vx_known || (uses_vy && !vy_known)) {
+				known &= ~(1 << vx);
+				if (flag_out) known &= ~(1 << 0xF);
+				break;
+			}
+
+			uint16_t result = 0;
+			uint8_t flag = 0;
+			switch (instr->op) {
+			case IR_ADD:
+				result = values[vx] + values[vy];
+				flag = (result > 0xFF) ? 1 : 0;
+				break;
+			case IR_SUB:
+				result = values[vx] - values[vy];
+				flag = (values[vx] >= values[vy]) ? 1 : 0;
+				break;
+			case IR_SUBN:
+				result = values[vy] - values[vx];
+				flag = (values[vy] >= values[vx]) ? 1 : 0;
+				break;
+			case IR_SHR:
+				result = values[vx] >> 1;
+				flag = values[vx] & 0x1;
+				break;
+			case IR_SHL:
+				result = values[vx] << 1;
+				flag = values[vx] >> 7;
+				break;
+			}
+			instr->op = IR_LOAD_IMM;
+			instr->imm = result & 0xFF;
+			instr->y = flag;
+			known |= (1 << vx);
+			values[vx] = instr->imm;
+			if (flag_out) {
+				known |= (1 << 0xF);
+				values[0xF] = flag;
+			}
+			break;
+		}
+		case IR_RAND:
+			known &= ~(1 << vx);
+			break;
+		case IR_SET_I:
+			known |= (1 << IR_REG_I);
+			values[IR_REG_I] = instr->imm;
+			break;
+		case IR_ADD_I:
+			if (vx_known && values[vx] == 0) {
+				instr->op = IR_NOP;
+			}
+			else if (vx_known && (known & (1 << IR_REG_I))) {
+				instr->op = IR_SET_I;
+				instr->imm = (values[IR_REG_I] + values[vx]) & 0xFFFF;
+				values[IR_REG_I] = instr->imm;
+			}
+			else {
+				known &= ~(1 << IR_REG_I);
+			}
+			break;
+		case IR_FONT_I:
+			if (vx_known) {
+				instr->op = IR_SET_I;
+				instr->imm = values[vx] * 5;
+				known |= (1 << IR_REG_I);
+				values[IR_REG_I] = instr->imm;
+			}
+			else {
+				known &= ~(1 << IR_REG_I);
+			}
+			break;
+		case IR_LOAD_MEM:
+			known &= ~((2 << vx) - 1); // V0 -> Vx
+			break;
+		case IR_SKIP_EQ_IMM:
+		case IR_SKIP_NE_IMM:
+		case IR_SKIP_EQ:
+		case IR_SKIP_NE:
+		{
+			// A skip which is skipped itself is left alone, the instruction after it runs some of the time either way.
+			bool compare_imm = (instr->op == IR_SKIP_EQ_IMM || instr->op == IR_SKIP_NE_IMM);
+			if (skipped || !vx_known || (!compare_imm && !vy_known)) break;
+			bool equal = (values[vx] == (compare_imm ? instr->imm : values[vy]));
+			bool taken = (instr->op == IR_SKIP_EQ_IMM || instr->op == IR_SKIP_EQ) ? equal : !equal;
+			if (!taken) {
+				instr->op = IR_NOP;
+			}
+			else if (i + 1 < block->count) {
+				// The skipped instruction never runs.
+				instr->op = IR_NOP;
+				block->instrs[i + 1].op = IR_NOP;
+			}
+			// A taken skip over the last instruction has to jump over an opcode which is not in the block, so it stays.
+			break;
+		}
+		default:
+			break;
+		}
+
+		if (skipped) {
+			for (uint8_t reg = 0; reg <= IR_REG_I; reg++) {
+				if ((known & (1 << reg)) && (!(known_before & (1 << reg)) || values[reg] != values_before[reg])) known &= ~(1 << reg);
+			}
+		}
+	}
+}
+
+bool Chip8Engine_IR::getRegMasks(IR_INSTR * instr, uint32_t * reads, uint32_t * writes)
+{
+	*reads = 0;
+	*writes = 0;
+	switch (instr->op) {
+	case IR_NOP:
+		return true;
+	case IR_LOAD_IMM:
+		*writes = (1 << instr->x);
+		if (instr->flags & IR_FLAG_VF_OUT) *writes |= (1 << 0xF);
+		return true;
+	case IR_ADD_IMM:
+		*reads = (1 << instr->x);
+		*writes = (1 << instr->x);
+		return true;
+	case IR_MOV:
+		*reads = (1 << instr->y);
+		*writes = (1 << instr->x);
+		return true;
+	case IR_OR:
+	case IR_AND:
+	case IR_XOR:
+	case IR_ADD:
+	case IR_SUB:
+	case IR_SUBN:
+		*reads = (1 << instr->x) | (1 << instr->y);
+		*writes = (1 << instr->x);
+		if (instr->flags & IR_FLAG_VF_OUT) *writes |= (1 << 0xF);
+		return true;
+	case IR_SHR:
+	case IR_SHL:
+		*reads = (1 << instr->x);
+		*writes = (1 << instr->x);
+		if (instr->flags & IR_FLAG_VF_OUT) *writes |= (1 << 0xF);
+		return true;
+	case IR_RAND:
+		*writes = (1 << instr->x);
+		return true;
+	case IR_SET_I:
+		*writes = (1 << IR_REG_I);
+		return true;
+	case IR_ADD_I:
+		*reads = (1 << instr->x) | (1 << IR_REG_I);
+		*writes = (1 << IR_REG_I);
+		return true;
+	case IR_FONT_I:
+		*reads = (1 << instr->x);
+		*writes = (1 << IR_REG_I);
+		return true;
+	case IR_LOAD_MEM:
+		*reads = (1 << IR_REG_I);
+		*writes = (2 << instr->x) - 1;
+		return false;
+	default:
+		// Skips
+		*reads = (1 << instr->x);
+		if (instr->op == IR_SKIP_EQ || instr->op == IR_SKIP_NE) *reads |= (1 << instr->y);
+		return false;
+	}
+}
+
+void Chip8Engine_IR::passDeadFlags(IR_BLOCK * block)
+{
+	// Walk backwards, keeping the registers which are read before they are written again. Everything is still in use after the block.
+	uint32_t live = (2 << IR_REG_I) - 1;
+
+	for (int8_t i = block->count - 1; i >= 0; i--) {
+		IR_INSTR * instr = &block->instrs[i];
+		if (instr->op == IR_NOP) continue;
+
+		// Nothing reads this VF, so only Vx needs to be stored.
+		if ((instr->flags & IR_FLAG_VF_OUT) && !(live & (1 << 0xF))) instr->flags &= ~IR_FLAG_VF_OUT;
+
+		uint32_t reads, writes;
+		getRegMasks(instr, &reads, &writes);
+
+		// A skipped instruction might not run, so the registers it writes can still be read with their old values.
+		bool skipped = (i > 0 && isSkipOp(block->instrs[i - 1].op));
+		if (!skipped) live &= ~writes;
+		live |= reads;
+	}
+}
+
+void Chip8Engine_IR::passDeadStores(IR_BLOCK * block)
+{
+	// Same walk as passDeadFlags.
+	uint32_t live = (2 << IR_REG_I) - 1;
+
+	for (int8_t i = block->count - 1; i >= 0; i--) {
+		IR_INSTR * instr = &block->instrs[i];
+		if (instr->op == IR_NOP) continue;
+
+		uint32_t reads, writes;
+		bool removable = getRegMasks(instr, &reads, &writes);
+		if (removable && (writes & live) == 0) {
+			instr->op = IR_NOP;
+			continue;
+		}
+
+		bool skipped = (i > 0 && isSkipOp(block->instrs[i - 1].op));
+		if (!skipped) live &= ~writes;
+		live |= reads;
+	}
+}
\ No newline at end of file
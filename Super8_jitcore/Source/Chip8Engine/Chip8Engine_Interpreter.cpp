@@ -101,13 +101,7 @@ void Chip8Engine_Interpreter::handleOpcodeMSN_0() {
 	{
 		// 0x00E0: Clears the screen
 		// TODO: Check if correct.
-#ifdef USE_SDL_GRAPHICS
-		SDL_LockTexture(SDL_texture, NULL, (void**)&SDL_gfxmem, &SDL_pitch);
-		memset(SDL_gfxmem, 0x00, 64 * 32 * sizeof(SDL_gfxmem[0]));
-		SDL_UnlockTexture(SDL_texture);
-#else
 		C8_STATE::C8_clearGFXMem();
-#endif
 		// V[0xF] = 0; // Need to set VF to 0?
 		setDrawFlag(true);
 		break;
@@ -357,48 +351,26 @@ void Chip8Engine_Interpreter::handleOpcodeMSN_D() {
 				set to unset when the sprite is drawn, and to 0 if that doesnt happen */
 				// TODO: check if correct.
 				// Get X,Y position to start drawing from & number of rows to draw.
-	uint8_t xpixel = C8_STATE::cpu.V[(opcode & 0x0F00) >> 8];
-	uint8_t ypixel = C8_STATE::cpu.V[(opcode & 0x00F0) >> 4];
+	uint8_t xpixel = C8_STATE::cpu.V[(opcode & 0x0F00) >> 8] % GFX_XRES;
+	uint8_t ypixel = C8_STATE::cpu.V[(opcode & 0x00F0) >> 4] % GFX_YRES;
 	uint8_t nrows = (opcode & 0x000F);
 	// Set VF = 0 initially from specs (used for collision detection).
 	C8_STATE::cpu.V[0xF] = 0;
 
-	// Enter loop
-	// NOTE: xpos will contain values from 0 -> 7 (from specs), and ypos will contain values from 0 -> (max)15 (from specs/opcode). 
-	// Therefore safe to use uint8_t.
-#ifdef USE_SDL_GRAPHICS
-	SDL_LockTexture(SDL_texture, NULL, (void**)&SDL_gfxmem, &SDL_pitch);
-#endif
-	uint8_t row_pixel_data = 0; // Used to cache one row of pixel bit data from a font character.
-	size_t gfx_array_position = 0; // Used to cache position of graphics memory array when accessed.
+	// gfxmem is 1 bit per pixel, so each sprite row is shifted into a 16-bit window covering the 2 bytes of the screen row it lands on (the second is all 0's when xpixel is a multiple of 8).
+	// Sprites wrap around the edges of the screen. Same as the emitted code in Dynarec::handleOpcodeMSN_D.
+	uint8_t column = xpixel / NUM_BITS_PER_BYTE;
+	uint8_t shift = xpixel % NUM_BITS_PER_BYTE;
 	for (uint8_t ypos = 0; ypos < nrows; ypos++) {
-		row_pixel_data = C8_STATE::memory[C8_STATE::cpu.I + ypos];
-		for (uint8_t xpos = 0; xpos < NUM_BITS_PER_BYTE; xpos++) {
-			if ((row_pixel_data & (0x80 >> xpos)) != 0) {
-				gfx_array_position = ((ypixel + ypos) * GFX_XRES) + (xpixel + xpos);
-#ifdef USE_SDL_GRAPHICS
-				if (SDL_gfxmem[gfx_array_position] != 0) {
-					C8_STATE::cpu.V[0xF] = 1;
-					SDL_gfxmem[gfx_array_position] = 0x00000000;
-				}
-				else {
-					SDL_gfxmem[gfx_array_position] = 0x00FFFFFF;
-				}
-#else
-				if (C8_STATE::gfxmem[gfx_array_position] != 0) {
-					C8_STATE::cpu.V[0xF] = 1;
-					C8_STATE::gfxmem[gfx_array_position] = 0;
-				}
-				else {
-					C8_STATE::gfxmem[gfx_array_position] = 1;
-				}
-#endif
-			}
-		}
-	}
-#ifdef USE_SDL_GRAPHICS
-	SDL_UnlockTexture(SDL_texture);
-#endif
+		uint8_t * gfx_row = C8_STATE::gfxmem + ((ypixel + ypos) % GFX_YRES) * GFX_ROW_SZ;
+		uint16_t row_pixel_data = ((uint16_t)C8_STATE::memory[C8_STATE::cpu.I + ypos] << NUM_BITS_PER_BYTE) >> shift;
+		uint8_t * left = &gfx_row[column];
+		uint8_t * right = &gfx_row[(column + 1) % GFX_ROW_SZ];
+		// Any pixel which is set in both gets flipped to unset.
+		if (((*left & (row_pixel_data >> NUM_BITS_PER_BYTE)) | (*right & (row_pixel_data & 0xFF))) != 0) C8_STATE::cpu.V[0xF] = 1;
+		*left ^= (row_pixel_data >> NUM_BITS_PER_BYTE);
+		*right ^= (row_pixel_data & 0xFF);
+	}
 	setDrawFlag(true); // Set the draw flag to true.
 }
 
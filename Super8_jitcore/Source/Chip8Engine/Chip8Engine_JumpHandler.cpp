@@ -15,7 +15,15 @@ Chip8Engine_JumpHandler::Chip8Engine_JumpHandler()
 {
 	jump_list = new FastArrayList<JUMP_ENTRY>(1024);
 	jump_fill_list = new FastArrayList<int32_t>(1024);
-	cond_jump_list = new FastArrayList<COND_JUMP_ENTRY>(1024);
+	jump_link_list = new FastArrayList<JUMP_LINK_ENTRY>(4096);
+	jump_link_free_slot_list = new FastArrayList<int32_t>(4096);
+	for (int32_t i = 0; i < MEMORY_SZ; i++) {
+		jump_index_by_c8pc[i] = -1;
+		jump_link_head_to[i] = -1;
+	}
+	for (int32_t i = 0; i < MAX_NUM_CACHES; i++) {
+		jump_link_head_from[i] = -1;
+	}
 
 	// Register this component in logger
 	logger->registerComponent(this);
@@ -26,7 +34,8 @@ Chip8Engine_JumpHandler::~Chip8Engine_JumpHandler()
 	// Deregister this component in logger
 	logger->deregisterComponent(this);
 
-	delete cond_jump_list;
+	delete jump_link_free_slot_list;
+	delete jump_link_list;
 	delete jump_fill_list;
 	delete jump_list;
 }
@@ -48,67 +57,15 @@ int32_t Chip8Engine_JumpHandler::recordJumpEntry(uint16_t c8_to_)
 	logMessage(LOGLEVEL::L_INFO, buffer);
 #endif
 	jump_fill_list->push_back(jump_list->size() - 1);
+	if (c8_to_ < MEMORY_SZ) jump_index_by_c8pc[c8_to_] = jump_list->size() - 1;
 	return (jump_list->size() - 1);
 }
 
-int32_t Chip8Engine_JumpHandler::recordConditionalJumpEntry(uint16_t c8_from_, uint16_t c8_to_, uint8_t translator_cycles_, uint32_t * x86_address_jump_value_)
-{
-	COND_JUMP_ENTRY entry;
-	entry.c8_address_from = c8_from_;
-	entry.c8_address_to = c8_to_;
-	entry.x86_address_jump_value = x86_address_jump_value_;
-	entry.translator_cycles = translator_cycles_;
-	cond_jump_list->push_back(entry);
-#ifdef USE_VERBOSE
-	char buffer[1000];
-	sprintf_s(buffer, 1000, "Conditional Jump[%d] recorded. C8_from = 0x%.4X, C8_to = 0x%.4X, x86_address = 0x%.8X, cycles = %d.", cond_jump_list->size() - 1, c8_from_, c8_to_, (uint32_t)x86_address_jump_value_, translator_cycles_);
-	logMessage(LOGLEVEL::L_INFO, buffer);
-#endif
-	return (cond_jump_list->size() - 1);
-}
-
-void Chip8Engine_JumpHandler::decreaseConditionalCycle()
-{
-	for (int32_t i = 0; i < (int32_t)cond_jump_list->size(); i++) {
-		if (cond_jump_list->get_ptr(i)->translator_cycles > 0) {
-			cond_jump_list->get_ptr(i)->translator_cycles -= 1;
-		}
-	}
-}
-
-uint8_t Chip8Engine_JumpHandler::checkConditionalCycle()
-{
-	for (int32_t i = 0; i < (int32_t)cond_jump_list->size(); i++) {
-		uint8_t cycles = cond_jump_list->get_ptr(i)->translator_cycles;
-		if (cycles > 0) return cycles;
-	}
-	return 0;
-}
-
-void Chip8Engine_JumpHandler::checkAndFillConditionalJumpsByCycles()
-{
-	int32_t list_sz = cond_jump_list->size();
-	for (int32_t i = 0; i < list_sz; i++) {
-		if (cond_jump_list->get_ptr(i)->translator_cycles == 0) {
-			int32_t relative = (int32_t)((uint32_t)cache->getEndX86AddressCurrent() - (uint32_t)cond_jump_list->get_ptr(i)->x86_address_jump_value - sizeof(uint32_t)); // 4 is size of uint32_t, as eip is at the end of the jump instruction but we calculate the relative size based on the start address of the relative
-			*(cond_jump_list->get_ptr(i)->x86_address_jump_value) = relative;
-
-#ifdef USE_VERBOSE
-			char buffer[1000];
-			sprintf_s(buffer, 1000, "Conditional Jump[%d] updated! Value %d written to 0x%.8X (in cache[%d]).", i, relative, (uint32_t)cond_jump_list->get_ptr(i)->x86_address_jump_value, cache->findCacheIndexCurrent());
-			logMessage(LOGLEVEL::L_INFO, buffer);
-#endif
-
-			// remove entry after its been filled
-			cond_jump_list->remove(i);
-			list_sz = cond_jump_list->size(); // update list size again
-			i -= 1; // decrease i by 1 so it rechecks the current i'th value in the list (which would have been i+1 if there was no remove).
-		}
-	}
-}
-
 int32_t Chip8Engine_JumpHandler::findJumpEntry(uint16_t c8_to_)
 {
+	// There is only ever one entry per C8 PC, so a direct lookup is enough. Jumps outside of memory (never executed) are searched for.
+	if (c8_to_ < MEMORY_SZ) return jump_index_by_c8pc[c8_to_];
+
 	int32_t index = -1;
 	for (int32_t i = 0; i < (int32_t)jump_list->size(); i++) {
 		if (c8_to_ == jump_list->get_ptr(i)->c8_address_to) {
@@ -124,7 +81,7 @@ void Chip8Engine_JumpHandler::checkAndFillJumpsByStartC8PC()
 	// Function designed to be fast as it will be called many times.
 	int32_t list_sz = jump_fill_list->size();
 	if (list_sz > 0) {
-		CACHE_REGION * region = NULL;
+		uint8_t * x86_address_to = NULL;
 		int32_t jump_list_index;
 		int32_t cache_index;
 
@@ -132,8 +89,11 @@ void Chip8Engine_JumpHandler::checkAndFillJumpsByStartC8PC()
 			jump_list_index = jump_fill_list->get(i);
 			// Jump cache handling done by CacheHandler, so this function just updates the jump table locations
 			cache_index = cache->getCacheWritableByStartC8PC(jump_list->get_ptr(jump_list_index)->c8_address_to);
-			region = cache->getCacheInfoByIndex(cache_index);
-			jump_list->get_ptr(jump_list_index)->x86_address_to = region->x86_mem_address;
+			x86_address_to = cache->getEntryX86AddressByIndex(cache_index, jump_list->get_ptr(jump_list_index)->c8_address_to);
+			jump_list->get_ptr(jump_list_index)->x86_address_to = x86_address_to;
+
+			// Target is known now, so any emitted jumps to it can go there directly.
+			linkJumpsByC8PC(jump_list->get_ptr(jump_list_index)->c8_address_to, x86_address_to);
 
 			// remove entry after its been filled
 			jump_fill_list->remove(i);
@@ -145,10 +105,129 @@ void Chip8Engine_JumpHandler::checkAndFillJumpsByStartC8PC()
 
 void Chip8Engine_JumpHandler::clearFilledFlagByC8PC(uint16_t c8_pc)
 {
-	for (int32_t i = 0; i < (int32_t)jump_list->size(); i++) {
-		if (jump_list->get_ptr(i)->c8_address_to == c8_pc) {
-			jump_fill_list->push_back(i);
+	int32_t tblindex = findJumpEntry(c8_pc);
+	if (tblindex != -1 && jump_list->get_ptr(tblindex)->x86_address_to != NULL) {
+		jump_list->get_ptr(tblindex)->x86_address_to = NULL; // Not filled anymore (the cache has been freed).
+		jump_fill_list->push_back(tblindex);
+	}
+
+	// Direct jumps to the old cache need to go back through the interrupt.
+	unlinkJumpsByC8PC(c8_pc);
+}
+
+int32_t Chip8Engine_JumpHandler::recordJumpLinkEntry(uint16_t c8_to_, uint8_t * x86_address_link_)
+{
+	// Jumps outside of memory are never executed, so dont bother linking them.
+	if (c8_to_ >= MEMORY_SZ) return -1;
+
+	// Link sites are always in the cache currently being translated.
+	int32_t cache_index = cache->findCacheIndexCurrent();
+
+	JUMP_LINK_ENTRY entry;
+	entry.c8_address_to = c8_to_;
+	entry.x86_address_link = x86_address_link_;
+	memcpy(entry.x86_original_bytes, x86_address_link_, JUMP_LINK_SZ);
+	entry.linked = 0;
+	entry.cache_index_from = cache_index;
+	entry.next_link_to = jump_link_head_to[c8_to_];
+	entry.prev_link_to = -1;
+	entry.next_link_from = jump_link_head_from[cache_index];
+
+	// Reuse an empty slot if there is one, so the indexes in the lists never have to be shifted.
+	int32_t index;
+	if (jump_link_free_slot_list->size() > 0) {
+		index = jump_link_free_slot_list->pop_back();
+		*jump_link_list->get_ptr(index) = entry;
+	}
+	else {
+		index = (int32_t)jump_link_list->push_back(entry);
+	}
+
+	// Add to the front of both lists.
+	if (entry.next_link_to != -1) jump_link_list->get_ptr(entry.next_link_to)->prev_link_to = index;
+	jump_link_head_to[c8_to_] = index;
+	jump_link_head_from[cache_index] = index;
+#ifdef USE_VERBOSE
+	char buffer[1000];
+	sprintf_s(buffer, 1000, "Jump Link[%d] recorded. C8_to = 0x%.4X, x86_address_link = 0x%.8X.", index, c8_to_, (uint32_t)x86_address_link_);
+	logMessage(LOGLEVEL::L_INFO, buffer);
+#endif
+
+	// If the jump table entry is already filled, the target cache exists and the jump can be linked now.
+	int32_t tblindex = findJumpEntry(c8_to_);
+	if (tblindex != -1 && jump_list->get_ptr(tblindex)->x86_address_to != NULL) {
+		linkJumpsByC8PC(c8_to_, jump_list->get_ptr(tblindex)->x86_address_to);
+	}
+	return index;
+}
+
+void Chip8Engine_JumpHandler::linkJumpsByC8PC(uint16_t c8_to, uint8_t * x86_address_to)
+{
+	if (c8_to >= MEMORY_SZ) return;
+	for (int32_t i = jump_link_head_to[c8_to]; i != -1; i = jump_link_list->get_ptr(i)->next_link_to) {
+		JUMP_LINK_ENTRY * entry = jump_link_list->get_ptr(i);
+		if (entry->linked == 0) {
+			// Overwrite start of the interrupt with JMP rel32 (relative to the end of the JMP instruction).
+			int32_t relative = (int32_t)((uint32_t)x86_address_to - ((uint32_t)entry->x86_address_link + JUMP_LINK_SZ));
+			cache->arena->beginWrite();
+			*(entry->x86_address_link) = 0xE9;
+			*((int32_t *)(entry->x86_address_link + 1)) = relative;
+			entry->linked = 1;
+#ifdef USE_VERBOSE
+			char buffer[1000];
+			sprintf_s(buffer, 1000, "Jump Link[%d] linked. C8_to = 0x%.4X, 0x%.8X -> 0x%.8X.", i, c8_to, (uint32_t)entry->x86_address_link, (uint32_t)x86_address_to);
+			logMessage(LOGLEVEL::L_INFO, buffer);
+#endif
+		}
+	}
+}
+
+void Chip8Engine_JumpHandler::unlinkJumpsByC8PC(uint16_t c8_to)
+{
+	if (c8_to >= MEMORY_SZ) return;
+	for (int32_t i = jump_link_head_to[c8_to]; i != -1; i = jump_link_list->get_ptr(i)->next_link_to) {
+		JUMP_LINK_ENTRY * entry = jump_link_list->get_ptr(i);
+		if (entry->linked == 1) {
+			// Restore the interrupt, so the jump goes back through the dispatcher.
+			cache->arena->beginWrite();
+			memcpy(entry->x86_address_link, entry->x86_original_bytes, JUMP_LINK_SZ);
+			entry->linked = 0;
+#ifdef USE_VERBOSE
+			char buffer[1000];
+			sprintf_s(buffer, 1000, "Jump Link[%d] unlinked. C8_to = 0x%.4X.", i, c8_to);
+			logMessage(LOGLEVEL::L_INFO, buffer);
+#endif
+		}
+	}
+}
+
+void Chip8Engine_JumpHandler::removeJumpLinksByCacheIndex(int32_t cache_index, uint8_t * x86_from)
+{
+	// Rebuild the list of links inside this cache with only the ones before x86_from.
+	int32_t i = jump_link_head_from[cache_index];
+	jump_link_head_from[cache_index] = -1;
+	while (i != -1) {
+		JUMP_LINK_ENTRY * entry = jump_link_list->get_ptr(i);
+		int32_t next = entry->next_link_from;
+		if (entry->x86_address_link < x86_from) {
+			entry->next_link_from = jump_link_head_from[cache_index];
+			jump_link_head_from[cache_index] = i;
+		}
+		else {
+			// Remove from the target list and leave the slot empty for reuse.
+			if (entry->prev_link_to != -1) jump_link_list->get_ptr(entry->prev_link_to)->next_link_to = entry->next_link_to;
+			else jump_link_head_to[entry->c8_address_to] = entry->next_link_to;
+			if (entry->next_link_to != -1) jump_link_list->get_ptr(entry->next_link_to)->prev_link_to = entry->prev_link_to;
+			if (entry->linked == 1) {
+				// Restore the interrupt first, unlinkJumpsByC8PC can't find this link anymore once it is off the target list.
+				cache->arena->beginWrite();
+				memcpy(entry->x86_address_link, entry->x86_original_bytes, JUMP_LINK_SZ);
+			}
+			entry->x86_address_link = NULL;
+			entry->linked = 0;
+			jump_link_free_slot_list->push_back(i);
 		}
+		i = next;
 	}
 }
 
@@ -176,11 +255,12 @@ void Chip8Engine_JumpHandler::DEBUG_printJumpList()
 	}
 }
 
-void Chip8Engine_JumpHandler::DEBUG_printCondJumpList()
+void Chip8Engine_JumpHandler::DEBUG_printJumpLinkList()
 {
-	for (int32_t i = 0; i < (int32_t)cond_jump_list->size(); i++) {
+	for (int32_t i = 0; i < (int32_t)jump_link_list->size(); i++) {
+		if (jump_link_list->get_ptr(i)->x86_address_link == NULL) continue; // Empty slot
 		char buffer[1000];
-		sprintf_s(buffer, 1000, "CondJump[%d]: c8_address_from = 0x%.4X, c8_address_to = 0x%.4X, x86_address_jump_value = 0x%.8X, translator_cycles = %d.", i, cond_jump_list->get_ptr(i)->c8_address_from, cond_jump_list->get_ptr(i)->c8_address_to, (uint32_t)cond_jump_list->get_ptr(i)->x86_address_jump_value, cond_jump_list->get_ptr(i)->translator_cycles);
+		sprintf_s(buffer, 1000, "JumpLink[%d]: c8_address_to = 0x%.4X, x86_address_link = 0x%.8X, linked = %d.", i, jump_link_list->get_ptr(i)->c8_address_to, (uint32_t)jump_link_list->get_ptr(i)->x86_address_link, jump_link_list->get_ptr(i)->linked);
 		logMessage(LOGLEVEL::L_DEBUG, buffer);
 	}
 }
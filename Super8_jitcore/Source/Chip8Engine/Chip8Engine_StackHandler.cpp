@@ -26,6 +26,8 @@ void Chip8Engine_StackHandler::resetStack()
 	sp = 0;
 	for (int i = 0; i < NUM_STACK_LVLS; i++) {
 		stack[i].c8_address = 0x0;
+		x86_return_address[i] = NULL;
+		x86_return_generation[i] = STACK_NO_GENERATION;
 	}
 }
 
@@ -35,6 +37,8 @@ void Chip8Engine_StackHandler::setTopStack(STACK_ENTRY entry)
 	if (sp < 0xF) {
 		// Store address in stack
 		stack[sp].c8_address = entry.c8_address;
+		x86_return_address[sp] = NULL; // No prediction, 0x00EE will go through the dispatch table.
+		x86_return_generation[sp] = STACK_NO_GENERATION;
 		// Increment stack level by 1
 		sp++;
 	}
@@ -10,6 +10,7 @@
 class Chip8Engine_JumpHandler;
 class Chip8Engine_Interpreter;
 class Chip8Engine_Dynarec;
+class Chip8Engine_IR;
 class Chip8Engine_Timers;
 class Chip8Engine_CodeEmitter_x86;
 class Chip8Engine_CacheHandler;
@@ -23,6 +24,7 @@ namespace Chip8Globals {
 	Chip8Engine_Interpreter * interpreter;
 	Chip8Engine_StackHandler * stack;
 	Chip8Engine_Dynarec * dynarec;
+	Chip8Engine_IR * ir;
 	Chip8Engine_CacheHandler * cache;
 	Chip8Engine_JumpHandler * jumptbl;
 	Chip8Engine_CodeEmitter_x86 * emitter;
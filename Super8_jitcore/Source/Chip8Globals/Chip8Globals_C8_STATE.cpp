@@ -9,7 +9,7 @@ namespace Chip8Globals {
 	namespace C8_STATE {
 		C8_CPU cpu;
 		uint8_t * memory; // 4096 (0x1000) bytes of memory in total, assumed to be allocated before class initialisation.
-		uint8_t * gfxmem; // 2048 (64x32) array containing pixel data (1 or 0) TODO: might be able to change this into a bool array or multiple ints (efficiency)?
+		uint8_t * gfxmem; // 256 bytes of pixel data (64x32, 1 bit per pixel), see GFX_ROW_SZ. Drawn to directly by the emitted code for 0xDXYN.
 		uint16_t opcode; // 16-bit wide opcode holder
 		bool drawflag; // Ready to draw screen flag
 		uint16_t rom_sz;
@@ -1,7 +1,16 @@
 #include "stdafx.h"
 
+#include <cstdint>
+
+#include "Headers\Chip8Globals\Chip8Globals_Dynarec.h"
+
 namespace Chip8Globals {
 	namespace Dynarec {
 		bool block_finished;
+		uint32_t block_opcode_count;
+		uint16_t inline_return_pc = NO_INLINE_RETURN;
+		bool reg_alloc_block_start;
+		uint8_t reg_alloc_count = 0;
+		uint8_t reg_alloc_c8_reg[REG_ALLOC_MAX_REGS];
 	}
 }
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "stdafx.h"
+
+#include <cstdint>
+
+#include <SDL.h>
+
+#include "Headers\Globals.h"
+
+#include "Headers\Chip8Globals\Chip8Globals.h"
+#include "Headers\Chip8Globals\Chip8Globals_X86_HELPERS.h"
+#include "Headers\Chip8Engine\Chip8Engine_Interpreter.h"
+#include "Headers\Chip8Engine\Chip8Engine_Key.h"
+#include "Headers\Chip8Engine\Chip8Engine_Timers.h"
+
+#define X86_HELPER_YIELD_MS (1000 / 60) // Exit to the main loop at least this often from helpers, so the screen is drawn and events are polled even when the emitted code never exits by itself.
+
+namespace Chip8Globals {
+	namespace X86_HELPERS {
+		X86_HELPER_FUNC x86_helper_USE_INTERPRETER = helper_USE_INTERPRETER;
+		X86_HELPER_FUNC x86_helper_DRAW = helper_DRAW;
+		X86_HELPER_FUNC x86_helper_WAIT_FOR_KEYPRESS = helper_WAIT_FOR_KEYPRESS;
+		X86_HELPER_FUNC x86_helper_UPDATE_TIMERS = helper_UPDATE_TIMERS;
+
+		uint32_t yield_ticks = 0;
+#ifdef LIMIT_SPEED_BY_DRAW_CALLS
+		uint32_t old_ticks = 0;
+		uint32_t new_ticks = 0;
+		int32_t delta_ticks = 0;
+		const uint32_t limiter_max_time_slice = (1000 / TARGET_FRAMES_PER_SECOND);
+#endif
+
+		uint32_t shouldYield()
+		{
+			uint32_t ticks = SDL_GetTicks();
+			if (ticks - yield_ticks < X86_HELPER_YIELD_MS) return 0;
+			yield_ticks = ticks;
+			return 1;
+		}
+
+		uint32_t limitDrawCall()
+		{
+#ifdef LIMIT_SPEED_BY_DRAW_CALLS
+			// If defined, attempts to delay emulation by ((uint)1000/TARGET_FRAMES_PER_SECOND - execution time since last draw call)ms.
+			new_ticks = SDL_GetTicks();
+			delta_ticks = limiter_max_time_slice - (new_ticks - old_ticks);
+			if (delta_ticks > 0) SDL_Delay(delta_ticks);
+			old_ticks = SDL_GetTicks();
+
+			// A whole time slice has passed, so the frame is due now.
+			if (getDrawFlag()) {
+				yield_ticks = old_ticks;
+				return 1;
+			}
+#endif
+			return shouldYield();
+		}
+
+		uint32_t X86_HELPER_CALL helper_USE_INTERPRETER(uint32_t c8_opcode)
+		{
+			// Opcode hasnt been implemented in the dynarec yet, need to use interpreter
+			interpreter->setOpcode((uint16_t)c8_opcode);
+			interpreter->emulateCycle();
+			return limitDrawCall();
+		}
+
+		uint32_t X86_HELPER_CALL helper_DRAW(uint32_t c8_opcode)
+		{
+			// The sprite has already been drawn into C8_STATE::gfxmem by the emitted code (see Dynarec::handleOpcodeMSN_D), only the frame is left to do.
+			setDrawFlag(true);
+			return limitDrawCall();
+		}
+
+		uint32_t X86_HELPER_CALL helper_WAIT_FOR_KEYPRESS(uint32_t c8_opcode)
+		{
+			// Only one opcode: 0xFX0A: A key press is awaited, then stored in Vx.
+			// Check if there has been a key press, and if so, store it in key->x86_key_pressed
+			uint8_t keystate = 0;
+			for (int i = 0; i < NUM_KEYS; i++) {
+				keystate = key->getKeyState(i); // Get the keystate from the key object.
+				if (keystate == 1) {
+					key->X86_KEY_PRESSED = i; // Set Vx to the key pressed (0x0 -> 0xF). See dynarec
+					break;
+				}
+			}
+			// Key states are only updated by the main loop.
+			return shouldYield();
+		}
+
+		uint32_t X86_HELPER_CALL helper_UPDATE_TIMERS(uint32_t c8_opcode)
+		{
+			uint8_t vx = (c8_opcode & 0x0F00) >> 8;
+			timers->TIMERS_SPIN_LOCK();
+			switch (c8_opcode & 0xF0FF)
+			{
+			case 0xF007:
+			{
+				// 0xFX07: Sets Vx to the value of the delay timer.
+				C8_STATE::cpu.V[vx] = timers->getDelayTimer();
+				break;
+			}
+			case 0xF015:
+			{
+				// 0xFX15: Sets the delay timer to Vx.
+				timers->setDelayTimer(C8_STATE::cpu.V[vx]);
+				break;
+			}
+			case 0xF018:
+			{
+				// 0xFX18: Sets the sound timer to Vx.
+				timers->setSoundTimer(C8_STATE::cpu.V[vx]);
+				break;
+			}
+			default:
+			{
+				// Never emitted for other opcodes.
+				break;
+			}
+			}
+			timers->TIMERS_SPIN_UNLOCK();
+			return shouldYield();
+		}
+	}
+}
\ No newline at end of file
@@ -12,6 +12,7 @@ namespace Chip8Globals {
 		uint16_t x86_interrupt_c8_param2;
 		uint8_t * x86_interrupt_x86_param1; // used with out of code interrupts
 		X86_INT_STATUS_CODE x86_interrupt_status_code;
+		uint16_t x86_backward_jump_budget = BACKWARD_JUMP_BUDGET;
 
 #ifdef USE_DEBUG
 		char * x86_int_status_code_strings[] = {
@@ -23,7 +24,11 @@ namespace Chip8Globals {
 			"DEBUG",
 			"WAIT_FOR_KEYPRESS",
 			"PREPARE_FOR_STACK_JUMP",
-			"UPDATE_TIMERS"
+			"UPDATE_TIMERS",
+			"DISPATCH_MISS"
+#ifdef LIMIT_SPEED_BY_INSTRUCTIONS
+			, "DELAY_INSTRUCTION"
+#endif
 		};
 
 		void DEBUG_printX86_STATE()
@@ -34,6 +34,9 @@ extern "C" {
 // Function Declarations
 void setupSDL();
 void cleanupSDL();
+#ifdef USE_SDL_GRAPHICS
+void updateGFXTexture();
+#endif
 
 int main(int argc, char **argv) {
 	// Vars
@@ -138,6 +141,7 @@ int main(int argc, char **argv) {
 			// In this period where it is non-zero, no graphical updates will appear. However the emulator is working correctly, its just that there is nothing to update and show.
 			// When the graphics/system timings are implemented properly (ie: refresh rate is set properly), this will be less apparent.
 #ifdef USE_SDL_GRAPHICS
+			updateGFXTexture();
 			SDL_RenderClear(renderer);
 			if (gfx_texture != NULL) SDL_RenderCopy(renderer, gfx_texture, NULL, NULL);
 			if (render_fps_texture != NULL) SDL_RenderCopy(renderer, render_fps_texture, NULL, &render_fps_location);
@@ -179,4 +183,20 @@ void cleanupSDL() {
 	SDL_DestroyWindow(window);
 #endif
 	SDL_Quit();
-}
\ No newline at end of file
+}
+
+#ifdef USE_SDL_GRAPHICS
+void updateGFXTexture() {
+	// gfxmem is 1 bit per pixel (drawn to by the emitted code), so it is only expanded into the texture once per frame.
+	if (gfx_texture == NULL) return;
+	SDL_LockTexture(gfx_texture, NULL, (void**)&Chip8Globals::SDL_gfxmem, &Chip8Globals::SDL_pitch);
+	for (int y = 0; y < GFX_YRES; y++) {
+		uint32_t * texture_row = (uint32_t *)((uint8_t *)Chip8Globals::SDL_gfxmem + y * Chip8Globals::SDL_pitch);
+		for (int x = 0; x < GFX_XRES; x++) {
+			uint8_t pixel = Chip8Globals::C8_STATE::gfxmem[(y * GFX_ROW_SZ) + (x / NUM_BITS_PER_BYTE)] & (0x80 >> (x % NUM_BITS_PER_BYTE));
+			texture_row[x] = (pixel != 0) ? 0x00FFFFFF : 0x00000000;
+		}
+	}
+	SDL_UnlockTexture(gfx_texture);
+}
+#endif
\ No newline at end of file